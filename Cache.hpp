@@ -0,0 +1,107 @@
+#ifndef PANDEMIC_CACHE_HEADER_FILE
+#define PANDEMIC_CACHE_HEADER_FILE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/* Bounded cache of analysis results keyed by a 64 bit hash of the game state
+ * and the query, safe to share between threads and between copies of a
+ * tracker. Keys are split over independently locked shards, each evicting
+ * its least recently used entry when full.
+ *
+ * Every kind of result has its own tag, so a hash collision between two
+ * kinds can't hand back the wrong type.
+ */
+class ResultCache
+{
+public:
+	enum kind_t {FORECAST_BEST = 0, RESILIENT_BEST, CURE_ODDS, SIMULATION, N_KINDS};
+
+	explicit ResultCache(size_t capacity = 1 << 14)
+		: shard_capacity_(std::max<size_t>(capacity / n_shards, 1))
+	{
+	}
+
+	template<class T>
+	std::shared_ptr<const T> find(kind_t kind, uint64_t key)
+	{
+		auto &shard = shards_[key % n_shards];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto entry = shard.index.find(key);
+		if(entry == shard.index.end() || entry->second->kind != kind)
+		{
+			misses_++;
+			return nullptr;
+		}
+
+		shard.lru.splice(shard.lru.begin(), shard.lru, entry->second);
+		hits_++;
+		return std::static_pointer_cast<const T>(entry->second->value);
+	}
+
+	template<class T>
+	std::shared_ptr<const T> insert(kind_t kind, uint64_t key, T value)
+	{
+		auto ret = std::make_shared<const T>(std::move(value));
+		auto &shard = shards_[key % n_shards];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		if(auto entry = shard.index.find(key); entry != shard.index.end())
+		{
+			shard.lru.erase(entry->second);
+			shard.index.erase(entry);
+		}
+
+		shard.lru.push_front({key, kind, ret});
+		shard.index[key] = shard.lru.begin();
+		if(shard.lru.size() > shard_capacity_)
+		{
+			shard.index.erase(shard.lru.back().key);
+			shard.lru.pop_back();
+		}
+
+		return ret;
+	}
+
+	size_t hits() const { return hits_; }
+	size_t misses() const { return misses_; }
+	size_t size() const
+	{
+		size_t n = 0;
+		for(auto &shard : shards_)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			n += shard.lru.size();
+		}
+		return n;
+	}
+
+private:
+	static const size_t n_shards = 16;
+
+	struct entry_t
+	{
+		uint64_t key;
+		kind_t kind;
+		std::shared_ptr<const void> value;
+	};
+
+	struct shard_t
+	{
+		mutable std::mutex mutex;
+		std::list<entry_t> lru;
+		std::unordered_map<uint64_t, std::list<entry_t>::iterator> index;
+	};
+
+	size_t shard_capacity_;
+	std::array<shard_t, n_shards> shards_;
+	std::atomic<size_t> hits_{0};
+	std::atomic<size_t> misses_{0};
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "Follow.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LogFollower::LogFollower(const std::string &filename)
+{
+	file_ = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if(file_ < 0)
+		return;
+
+	inotify_ = inotify_init1(IN_CLOEXEC);
+	if(inotify_ >= 0 && inotify_add_watch(inotify_, filename.c_str(),
+			IN_MODIFY | IN_DELETE_SELF | IN_MOVE_SELF) < 0)
+	{
+		close(inotify_);
+		inotify_ = -1;
+	}
+}
+
+LogFollower::~LogFollower()
+{
+	if(file_ >= 0)
+		close(file_);
+	if(inotify_ >= 0)
+		close(inotify_);
+}
+
+LogFollower::event_t LogFollower::wait(std::vector<std::string> &lines,
+									   int stop_fd)
+{
+	lines.clear();
+	while(true)
+	{
+		// a writer that shortened the file has started the log over
+		struct stat st;
+		if(fstat(file_, &st) < 0)
+			return FAILED;
+		if(st.st_size < offset_)
+		{
+			lseek(file_, 0, SEEK_SET);
+			offset_ = 0;
+			partial_.clear();
+			return TRUNCATED;
+		}
+
+		if(!read_lines(lines))
+			return FAILED;
+		if(!lines.empty())
+			return LINES;
+		if(gone_)
+			return GONE;
+
+		pollfd fds[] = {{inotify_, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+		if(poll(fds, 2, -1) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return FAILED;
+		}
+
+		if(fds[1].revents)
+			return STOPPED;
+
+		alignas(inotify_event) char events[4096];
+		ssize_t length = read(inotify_, events, sizeof(events));
+		if(length < 0 && errno != EINTR)
+			return FAILED;
+
+		for(ssize_t i = 0; i < length;)
+		{
+			auto *event = reinterpret_cast<inotify_event *>(events + i);
+			if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+			{
+				// pick up what was written before it went
+				gone_ = true;
+				read_lines(lines);
+				return lines.empty()? GONE : LINES;
+			}
+			i += sizeof(inotify_event) + event->len;
+		}
+	}
+}
+
+bool LogFollower::read_lines(std::vector<std::string> &lines)
+{
+	char buffer[65536];
+	ssize_t length;
+	while((length = read(file_, buffer, sizeof(buffer))) != 0)
+	{
+		if(length < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+
+		offset_ += length;
+		size_t start = 0;
+		for(ssize_t i = 0; i < length; i++)
+		{
+			if(buffer[i] != '\n')
+				continue;
+
+			partial_.append(buffer + start, i - start);
+			lines.push_back(std::move(partial_));
+			partial_.clear();
+			start = i + 1;
+		}
+		partial_.append(buffer + start, length - start);
+	}
+
+	return true;
+}
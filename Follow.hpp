@@ -0,0 +1,41 @@
+#ifndef PANDEMIC_FOLLOW_HEADER_FILE
+#define PANDEMIC_FOLLOW_HEADER_FILE
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+/* Follows a log file as another program appends to it, handing back each
+ * whole line once. Waits on inotify, so it wakes as soon as a write lands
+ * instead of polling the file.
+ */
+class LogFollower
+{
+public:
+	enum event_t {LINES = 0, STOPPED, TRUNCATED, GONE, FAILED};
+
+	// starts from the beginning, so the lines already there come first
+	explicit LogFollower(const std::string &filename);
+	~LogFollower();
+	LogFollower(const LogFollower&) = delete;
+	LogFollower& operator= (const LogFollower&) = delete;
+
+	bool good() const { return file_ >= 0 && inotify_ >= 0; }
+
+	// blocks until there are new lines or stop_fd is readable. After
+	// TRUNCATED the log is read again from the beginning.
+	event_t wait(std::vector<std::string> &lines, int stop_fd);
+
+private:
+	// reads to the end of the file, keeping any unfinished last line
+	bool read_lines(std::vector<std::string> &lines);
+
+	int file_ = -1;
+	int inotify_ = -1;
+	off_t offset_ = 0;
+	std::string partial_;
+	// the log was deleted or moved, so nothing more will arrive
+	bool gone_ = false;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef PANDEMIC_HASH_HEADER_FILE
+#define PANDEMIC_HASH_HEADER_FILE
+
+#include <cstdint>
+
+// splitmix64's finaliser, spreading every input bit over the whole key
+inline uint64_t mix64(uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+	return x ^ (x >> 31);
+}
+
+#endif
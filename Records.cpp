@@ -0,0 +1,747 @@
+#include "Records.hpp"
+
+#include <ostream>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <cstdint>
+
+namespace {
+
+	const char * formats[] = {
+		[RecordWriter::TEXT] = "text",
+		[RecordWriter::JSON] = "json",
+		[RecordWriter::BINARY] = "binary"
+	};
+
+	const char * ops[] = {
+		[RecordWriter::DRAW] = "draw",
+		[RecordWriter::UNDRAW] = "undraw",
+		[RecordWriter::INFECT] = "infect",
+		[RecordWriter::UNINFECT] = "uninfect",
+		[RecordWriter::EPIDEMIC] = "epidemic",
+		[RecordWriter::UNEPIDEMIC] = "unepidemic",
+		[RecordWriter::FORECAST] = "forecast",
+		[RecordWriter::RESILIENT_POPULATION] = "resilient_population",
+		[RecordWriter::GIVE] = "give",
+		[RecordWriter::DISCARD] = "discard",
+		[RecordWriter::REVEAL_DRAW] = "reveal_draw",
+		[RecordWriter::REVEAL_INFECT] = "reveal_infect",
+		[RecordWriter::STATION] = "station",
+		[RecordWriter::UNSTATION] = "unstation"
+	};
+
+	const char * statuses[] = {
+		[Tracker::OK] = "ok",
+		[Tracker::AMBIGUOUS] = "ambiguous",
+		[Tracker::INVALID] = "invalid",
+		[Tracker::NOT_IN_PILE] = "not_in_pile",
+		[Tracker::EMPTY_DECK] = "empty_deck",
+		[Tracker::OVER_RATE] = "over_rate",
+		[Tracker::BAD_ARGUMENT] = "bad_argument"
+	};
+
+	const int no_card = 0xff;
+
+}  /* namespace  */
+
+RecordWriter::format_t to_format(const std::string &str)
+{
+	for(int i = 0; i < RecordWriter::N_FORMATS; i++)
+		if(str == formats[i]) return static_cast<RecordWriter::format_t>(i);
+
+	return RecordWriter::N_FORMATS;
+}
+
+RecordWriter::RecordWriter(std::ostream &out, format_t format)
+	: out_(out), format_(format)
+{
+}
+
+void RecordWriter::cities(const Tracker &tracker)
+{
+	const auto &cities = tracker.cities();
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"cities\",\"cards\":[";
+		for(auto card = cities.begin(); card != cities.end(); ++card)
+		{
+			out_ << (card == cities.begin()? "{\"name\":" : ",{\"name\":");
+			json_string(card->first);
+			out_ << ",\"color\":\"" << color_to_string(card->second) << "\"}";
+		}
+		out_ << "]}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		size_t length = 1;
+		for(const auto &card : cities)
+			length += 2 + card.first.size();
+
+		header(CITIES, length);
+		u8(cities.size());
+		for(const auto &card : cities)
+		{
+			u8(card.second);
+			u8(card.first.size());
+			out_.write(card.first.data(), card.first.size());
+		}
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::card(const Tracker &tracker, op_t op,
+						const std::string &input, Tracker::result_t result)
+{
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"card\",\"op\":\"" << ops[op] << "\",\"input\":";
+		json_string(input);
+		out_ << ",\"status\":\"" << statuses[result.status] << "\",\"card\":";
+		if(result.card)
+		{
+			json_string(result.card->first);
+			out_ << ",\"color\":\"" << color_to_string(result.card->second) << "\"";
+		}
+		else
+		{
+			out_ << "null";
+		}
+		out_ << "}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		header(CARD, 3);
+		u8(op);
+		u8(result.status);
+		u8(result.card? index(tracker, result.card) : no_card);
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::epidemic_stats(const Tracker &tracker)
+{
+	auto [safe_phase, next_phase] = tracker.epidemic_window();
+	int draws_left = tracker.total_cards() - tracker.n_draws();
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"epidemic_stats\",\"epidemics\":";
+		out_ << tracker.current_epidemics() << ",\"draws\":" << tracker.n_draws();
+		out_ << ",\"draws_left\":" << draws_left << ",\"safe_phase\":";
+		out_ << safe_phase << ",\"next_phase\":" << next_phase;
+		out_ << ",\"infects\":" << tracker.n_infects() << ",\"expected\":";
+		out_ << tracker.expected_infects() << "}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		header(EPIDEMIC_STATS, 14);
+		i16(tracker.current_epidemics());
+		i16(tracker.n_draws());
+		i16(draws_left);
+		i16(safe_phase);
+		i16(next_phase);
+		i16(tracker.n_infects());
+		i16(tracker.expected_infects());
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::infect_stats(const Tracker &tracker)
+{
+	const auto &discard = tracker.infection_discard();
+	const auto &strata = tracker.infection_deck();
+	const auto &unknowns = tracker.unknown_infects();
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"infect_stats\",\"discard\":";
+		json_cards(discard);
+		out_ << ",\"strata\":[";
+		for(auto i = strata.rbegin(); i != strata.rend(); ++i)
+		{
+			if(i != strata.rbegin())
+				out_ << ",";
+			json_cards(*i);
+		}
+		out_ << "],\"unknown\":[";
+		for(auto i = unknowns.rbegin(); i != unknowns.rend(); ++i)
+			out_ << (i == unknowns.rbegin()? "" : ",") << *i;
+		out_ << "]}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		// each stratum's cards are followed by how many were infected unseen
+		size_t length = 2 + discard.size();
+		for(const auto &stratum : strata)
+			length += 2 + stratum.size();
+
+		header(INFECT_STATS, length);
+		indices(tracker, discard);
+		u8(strata.size());
+		for(size_t i = strata.size(); i-- > 0;)
+		{
+			indices(tracker, strata[i]);
+			u8(unknowns[i]);
+		}
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::card_stats(const Tracker &tracker)
+{
+	const auto &deck = tracker.player_deck();
+	int counts[N_COLORS] = {0};
+	for(const auto &card : deck)
+		++counts[card.second];
+
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"card_stats\",\"deck\":";
+		json_cards(deck);
+		out_ << ",\"counts\":{";
+		for(int color = 0; color < N_COLORS; color++)
+		{
+			out_ << (color? ",\"" : "\"") << color_to_string(color_t(color));
+			out_ << "\":" << counts[color];
+		}
+		out_ << "},\"unknown\":" << tracker.unknown_draws() << "}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		header(CARD_STATS, 2 + deck.size() + N_COLORS);
+		indices(tracker, deck);
+		for(int color = 0; color < N_COLORS; color++)
+			u8(counts[color]);
+		u8(tracker.unknown_draws());
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::forecast_best(const Tracker &tracker,
+								 const std::vector<ranked_forecast_t> &ranked)
+{
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"forecast_best\",\"risk_horizon\":";
+		out_ << Tracker::risk_horizon << ",\"rankings\":[";
+		for(auto r = ranked.begin(); r != ranked.end(); ++r)
+		{
+			out_ << (r == ranked.begin()? "{\"risk\":" : ",{\"risk\":");
+			out_ << r->risk << ",\"cards\":[";
+			for(auto card = r->cards.begin(); card != r->cards.end(); ++card)
+			{
+				if(card != r->cards.begin())
+					out_ << ",";
+				json_string((*card)->first);
+			}
+			out_ << "]}";
+		}
+		out_ << "]}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		size_t length = 2;
+		for(const auto &r : ranked)
+			length += 9 + r.cards.size();
+
+		header(FORECAST_BEST, length);
+		u8(Tracker::risk_horizon);
+		u8(ranked.size());
+		for(const auto &r : ranked)
+		{
+			f64(r.risk);
+			u8(r.cards.size());
+			for(const auto *card : r.cards)
+				u8(index(tracker, card));
+		}
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::resilient_best(const Tracker &tracker,
+	const std::vector<std::pair<double, const card_t *>> &ranked)
+{
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"resilient_best\",\"risk_horizon\":";
+		out_ << Tracker::risk_horizon << ",\"rankings\":[";
+		for(auto r = ranked.begin(); r != ranked.end(); ++r)
+		{
+			out_ << (r == ranked.begin()? "{\"risk\":" : ",{\"risk\":");
+			out_ << r->first << ",\"card\":";
+			json_string(r->second->first);
+			out_ << "}";
+		}
+		out_ << "]}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		header(RESILIENT_BEST, 2 + 9 * ranked.size());
+		u8(Tracker::risk_horizon);
+		u8(ranked.size());
+		for(const auto &[risk, card] : ranked)
+		{
+			f64(risk);
+			u8(index(tracker, card));
+		}
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::hands(const Tracker &tracker)
+{
+	const auto &hands = tracker.hands();
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"hands\",\"hands\":{";
+		for(auto hand = hands.begin(); hand != hands.end(); ++hand)
+		{
+			out_ << (hand == hands.begin()? "\"" : ",\"") << hand->first << "\":";
+			json_cards(hand->second);
+		}
+		out_ << "}}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		size_t length = 1;
+		for(const auto &hand : hands)
+			length += 2 + hand.second.size();
+
+		header(HANDS, length);
+		u8(hands.size());
+		for(const auto &hand : hands)
+		{
+			u8(hand.first);
+			indices(tracker, hand.second);
+		}
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::cure_odds(int turns, const cure_odds_t &odds)
+{
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"cure_odds\",\"turns\":" << turns << ",\"odds\":{";
+		for(int color = 0; color < EVENT; color++)
+		{
+			out_ << (color? ",\"" : "\"") << color_to_string(color_t(color));
+			out_ << "\":" << odds[color];
+		}
+		out_ << "}}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		header(CURE_ODDS, 1 + 8 * EVENT);
+		u8(turns);
+		for(double x : odds)
+			f64(x);
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::pile_odds(const Tracker &tracker, const card_t *card,
+							 const pile_odds_t &odds)
+{
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"pile_odds\",\"card\":";
+		json_string(card->first);
+		out_ << ",\"odds\":{";
+		for(int pile = 0; pile < N_PILES; pile++)
+		{
+			out_ << (pile? ",\"" : "\"") << pile_to_string(pile_t(pile));
+			out_ << "\":" << odds[pile];
+		}
+		out_ << "}}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		header(PILE_ODDS, 1 + 8 * N_PILES);
+		u8(index(tracker, card));
+		for(double x : odds)
+			f64(x);
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::route(const Tracker &tracker, int from, int to,
+						 const std::vector<int> &path)
+{
+	const auto &cities = tracker.cities();
+	auto city = [&cities](int i) { return std::next(cities.begin(), i)->first; };
+	int actions = tracker.routes().distance(from, to);
+
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"route\",\"from\":";
+		json_string(city(from));
+		out_ << ",\"to\":";
+		json_string(city(to));
+		out_ << ",\"actions\":";
+		if(actions == RouteMap::unreachable)
+			out_ << "null";
+		else
+			out_ << actions;
+		out_ << ",\"path\":[";
+		for(size_t i = 0; i < path.size(); i++)
+		{
+			out_ << (i? "," : "");
+			json_string(city(path[i]));
+		}
+		out_ << "]}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		header(ROUTE, 4 + path.size());
+		u8(from);
+		u8(to);
+		u8(actions);
+		u8(path.size());
+		for(int i : path)
+			u8(i);
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::distances(const Tracker &tracker, int from)
+{
+	const auto &routes = tracker.routes();
+
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"distances\",\"from\":";
+		json_string(std::next(tracker.cities().begin(), from)->first);
+		out_ << ",\"actions\":{";
+		int i = 0;
+		const char *separator = "";
+		for(const auto &card : tracker.cities())
+		{
+			if(routes.distance(from, i) != RouteMap::unreachable)
+			{
+				out_ << separator;
+				json_string(card.first);
+				out_ << ":" << routes.distance(from, i);
+				separator = ",";
+			}
+			i++;
+		}
+		out_ << "}}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		header(DISTANCES, 2 + routes.size());
+		u8(from);
+		u8(routes.size());
+		for(int to = 0; to < routes.size(); to++)
+			u8(routes.distance(from, to));
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::turn(const Tracker &tracker, const Tracker::turn_t &turn,
+						const Tracker::turn_result_t &result)
+{
+	bool ok = result.result.status == Tracker::OK;
+	const std::vector<std::string> *events[] = {&turn.draws, &turn.epidemics,
+												&turn.infections};
+	const char * names[] = {"draws", "epidemics", "infections"};
+	int rate = infection_rate(tracker.current_epidemics());
+	std::string input = result.input? *result.input : "";
+
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"turn\",\"status\":\"";
+		out_ << statuses[result.result.status] << "\",\"input\":";
+		if(result.input)
+			json_string(input);
+		else
+			out_ << "null";
+		out_ << ",\"player\":";
+		if(turn.player >= 0)
+			out_ << turn.player;
+		else
+			out_ << "null";
+		for(int i = 0; i < 3; i++)
+		{
+			out_ << ",\"" << names[i] << "\":[";
+			for(size_t j = 0; ok && j < events[i]->size(); j++)
+			{
+				const auto &name = (*events[i])[j];
+				out_ << (j? "," : "");
+				if(name.empty())
+					out_ << "null";
+				else
+					json_string(tracker.resolve(name).card->first);
+			}
+			out_ << "]";
+		}
+		out_ << ",\"rate\":" << rate << ",\"infects\":" << tracker.n_infects();
+		out_ << ",\"expected\":" << tracker.expected_infects() << "}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		input.resize(std::min<size_t>(input.size(), 0xff));
+		size_t length = 7 + 3 + 1 + input.size();
+		for(const auto *list : events)
+			length += ok? list->size() : 0;
+		header(TURN, length);
+		u8(result.result.status);
+		u8(turn.player >= 0? turn.player : no_card);
+		u8(rate);
+		i16(tracker.n_infects());
+		i16(tracker.expected_infects());
+		for(const auto *list : events)
+		{
+			u8(ok? list->size() : 0);
+			for(size_t j = 0; ok && j < list->size(); j++)
+			{
+				const auto &name = (*list)[j];
+				u8(name.empty()? no_card : index(tracker, tracker.resolve(name).card));
+			}
+		}
+		u8(input.size());
+		out_.write(input.data(), input.size());
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::estimate(const Tracker &tracker,
+							InfectionSampler::query_t query, int turns,
+							const card_t *city, const estimate_t &estimate,
+							bool final)
+{
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"estimate\",\"query\":\"" << query_to_string(query);
+		out_ << "\",\"turns\":" << turns << ",\"city\":";
+		if(city)
+			json_string(city->first);
+		else
+			out_ << "null";
+		out_ << ",\"mean\":" << estimate.mean << ",\"half_width\":";
+		out_ << (estimate.samples? estimate.half_width() : 0.0);
+		out_ << ",\"samples\":" << estimate.samples;
+		out_ << ",\"final\":" << (final? "true" : "false") << "}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		header(ESTIMATE, 4 + 4 + 16);
+		u8(query);
+		u8(turns);
+		u8(city? index(tracker, city) : no_card);
+		u8(final);
+		u32(std::min<long>(estimate.samples, UINT32_MAX));
+		f64(estimate.mean);
+		f64(estimate.samples? estimate.half_width() : 0.0);
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::game(const Tracker &tracker, const game_record_t &game)
+{
+	const auto &cities = tracker.cities();
+	auto city = [&cities](int i) { return std::next(cities.begin(), i)->first; };
+	auto json_list = [&](const std::vector<int> &cards)
+	{
+		out_ << "[";
+		for(size_t i = 0; i < cards.size(); i++)
+		{
+			out_ << (i? "," : "");
+			json_string(city(cards[i]));
+		}
+		out_ << "]";
+	};
+	auto binary_list = [this](const std::vector<int> &cards)
+	{
+		u8(cards.size());
+		for(int i : cards)
+			u8(i);
+	};
+
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"game\",\"game\":" << game.game;
+		out_ << ",\"players\":" << game.players << ",\"outcome\":\"";
+		out_ << outcome_to_string(game.outcome) << "\",\"cures\":[";
+		const char *separator = "";
+		for(int color = 0; color < EVENT; color++)
+		{
+			if((game.cures >> color) & 1)
+			{
+				out_ << separator << "\"" << color_to_string(color_t(color)) << "\"";
+				separator = ",";
+			}
+		}
+		out_ << "],\"outbreaks\":" << game.outbreaks << ",\"setup_infections\":";
+		json_list(game.setup_infections);
+		out_ << ",\"hands\":[";
+		for(size_t i = 0; i < game.hands.size(); i++)
+		{
+			out_ << (i? "," : "");
+			json_list(game.hands[i]);
+		}
+		out_ << "],\"turns\":[";
+		for(size_t i = 0; i < game.turns.size(); i++)
+		{
+			const auto &turn = game.turns[i];
+			out_ << (i? ",{" : "{") << "\"player\":" << turn.player;
+			out_ << ",\"stations\":";
+			json_list(turn.stations);
+			out_ << ",\"draws\":";
+			json_list(turn.draws);
+			out_ << ",\"epidemics\":";
+			json_list(turn.epidemics);
+			out_ << ",\"infections\":";
+			json_list(turn.infections);
+			out_ << ",\"discards\":";
+			json_list(turn.discards);
+			out_ << "}";
+		}
+		out_ << "]}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		size_t length = 10 + 1 + game.setup_infections.size();
+		for(const auto &hand : game.hands)
+			length += 1 + hand.size();
+		for(const auto &turn : game.turns)
+			length += 6 + turn.stations.size() + turn.draws.size() +
+				turn.epidemics.size() + turn.infections.size() +
+				turn.discards.size();
+
+		header(GAME, length);
+		u32(game.game);
+		u8(game.players);
+		u8(game.outcome);
+		u8(game.cures);
+		u8(game.outbreaks);
+		i16(game.turns.size());
+		binary_list(game.setup_infections);
+		for(const auto &hand : game.hands)
+			binary_list(hand);
+		for(const auto &turn : game.turns)
+		{
+			u8(turn.player);
+			binary_list(turn.stations);
+			binary_list(turn.draws);
+			binary_list(turn.epidemics);
+			binary_list(turn.infections);
+			binary_list(turn.discards);
+		}
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::error(const std::string &message)
+{
+	if(format_ == JSON)
+	{
+		out_ << "{\"type\":\"error\",\"message\":";
+		json_string(message);
+		out_ << "}\n";
+	}
+	else if(format_ == BINARY)
+	{
+		auto length = std::min<size_t>(message.size(), 0xff);
+		header(ERROR, 1 + length);
+		u8(length);
+		out_.write(message.data(), length);
+	}
+
+	out_.flush();
+}
+
+void RecordWriter::json_string(const std::string &s)
+{
+	static const char hex[] = "0123456789abcdef";
+	out_ << '"';
+	for(unsigned char c : s)
+	{
+		if(c == '"' || c == '\\')
+			out_ << '\\' << c;
+		else if(c < 0x20)
+			out_ << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+		else
+			out_ << c;
+	}
+	out_ << '"';
+}
+
+void RecordWriter::json_cards(const deck_t &pile)
+{
+	out_ << '[';
+	for(auto card = pile.begin(); card != pile.end(); ++card)
+	{
+		if(card != pile.begin())
+			out_ << ',';
+		json_string(card->first);
+	}
+	out_ << ']';
+}
+
+void RecordWriter::header(record_t type, size_t length)
+{
+	u8(type);
+	u8(length & 0xff);
+	u8(length >> 8);
+}
+
+void RecordWriter::u8(int n)
+{
+	out_.put(static_cast<char>(n & 0xff));
+}
+
+void RecordWriter::i16(int n)
+{
+	u8(n);
+	u8(n >> 8);
+}
+
+void RecordWriter::u32(uint32_t n)
+{
+	i16(n);
+	i16(n >> 16);
+}
+
+void RecordWriter::f64(double x)
+{
+	uint64_t bits;
+	std::memcpy(&bits, &x, sizeof(bits));
+	for(int byte = 0; byte < 8; byte++)
+		u8(bits >> (8 * byte));
+}
+
+int RecordWriter::index(const Tracker &tracker, const card_t *card) const
+{
+	const auto &cities = tracker.cities();
+	return std::distance(cities.begin(), cities.find(card->first));
+}
+
+void RecordWriter::indices(const Tracker &tracker, const deck_t &pile)
+{
+	// piles are sorted like the cities, so one pass over both finds them all
+	u8(pile.size());
+	auto city = tracker.cities().begin();
+	int i = 0;
+	for(const auto &card : pile)
+	{
+		for(; static_cast<const std::string &>(city->first) != card.first; ++city)
+			i++;
+		u8(i);
+	}
+}
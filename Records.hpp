@@ -0,0 +1,94 @@
+#ifndef PANDEMIC_RECORDS_HEADER_FILE
+#define PANDEMIC_RECORDS_HEADER_FILE
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "Tracker.hpp"
+#include "Simulation.hpp"
+#include "SelfPlay.hpp"
+
+/* Writes command results as machine readable records, either one JSON
+ * object per line or a compact binary encoding, straight from the tracker's
+ * piles.
+ *
+ * Binary records are a type byte and a little endian 16 bit payload length,
+ * then the payload. Cards are single bytes indexing the cities record
+ * (0xff for none, as for cards taken unseen), so a reader needs the cities
+ * record before the rest.
+ * Counts are bytes, draw counts are signed 16 bit, a game's turns and
+ * sample counts are 16 and 32 bit, and risks are doubles.
+ */
+class RecordWriter
+{
+public:
+	enum format_t {TEXT = 0, JSON, BINARY, N_FORMATS};
+	enum record_t {CITIES = 1, CARD, EPIDEMIC_STATS, INFECT_STATS, CARD_STATS,
+				   FORECAST_BEST, RESILIENT_BEST, ERROR, HANDS, CURE_ODDS,
+				   PILE_ODDS, ESTIMATE, TURN, ROUTE, DISTANCES,
+				   GAME};
+	enum op_t {DRAW = 0, UNDRAW, INFECT, UNINFECT, EPIDEMIC, UNEPIDEMIC,
+			   FORECAST, RESILIENT_POPULATION, GIVE, DISCARD, REVEAL_DRAW,
+			   REVEAL_INFECT, STATION, UNSTATION, N_OPS};
+
+	explicit RecordWriter(std::ostream &out, format_t format = TEXT);
+
+	format_t format() const { return format_; }
+	void set_format(format_t format) { format_ = format; }
+	// whether commands should write records instead of prose
+	bool structured() const { return format_ != TEXT; }
+
+	// every card's name and color, in the order binary indices refer to
+	void cities(const Tracker &tracker);
+	// the outcome of one card of a command
+	void card(const Tracker &tracker, op_t op, const std::string &input,
+			  Tracker::result_t result);
+	void epidemic_stats(const Tracker &tracker);
+	void infect_stats(const Tracker &tracker);
+	void card_stats(const Tracker &tracker);
+	void forecast_best(const Tracker &tracker,
+					   const std::vector<ranked_forecast_t> &ranked);
+	void resilient_best(const Tracker &tracker,
+		const std::vector<std::pair<double, const card_t *>> &ranked);
+	// player numbers and the cards in their hands
+	void hands(const Tracker &tracker);
+	void cure_odds(int turns, const cure_odds_t &odds);
+	// where a card might be, indexed by pile_t
+	void pile_odds(const Tracker &tracker, const card_t *card,
+				   const pile_odds_t &odds);
+	// a shortest route between two cities, in cities numbered by index()
+	void route(const Tracker &tracker, int from, int to,
+			   const std::vector<int> &path);
+	// actions from one city to each of the others, 0xff for no way there
+	void distances(const Tracker &tracker, int from);
+	// the outcome of a turn and where the infection rate track stands
+	void turn(const Tracker &tracker, const Tracker::turn_t &turn,
+			  const Tracker::turn_result_t &result);
+	// a running estimate, final once sampling has stopped
+	void estimate(const Tracker &tracker, InfectionSampler::query_t query,
+				  int turns, const card_t *city, const estimate_t &estimate,
+				  bool final);
+	// a self-played game, in cities numbered by index()
+	void game(const Tracker &tracker, const game_record_t &game);
+	void error(const std::string &message);
+
+private:
+	void json_string(const std::string &s);
+	void json_cards(const deck_t &pile);
+	void header(record_t type, size_t length);
+	void u8(int n);
+	void i16(int n);
+	void u32(uint32_t n);
+	void f64(double x);
+	int index(const Tracker &tracker, const card_t *card) const;
+	void indices(const Tracker &tracker, const deck_t &pile);
+
+	std::ostream &out_;
+	format_t format_;
+};
+
+RecordWriter::format_t to_format(const std::string &str);
+
+#endif
@@ -0,0 +1,201 @@
+#include "Routes.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+connections_t load_connections(const std::string &filename)
+{
+	std::ifstream in(filename);
+	connections_t ret;
+
+	for(std::istream_iterator<std::string> it(in);
+		it != std::istream_iterator<std::string>(); ++it)
+	{
+		auto from = *it++;
+		if(it == std::istream_iterator<std::string>())
+			break;
+		ret.emplace_back(std::move(from), *it);
+	}
+
+	return ret;
+}
+
+RouteMap::RouteMap(const std::vector<std::string> &names,
+				   const connections_t &connections)
+	: n_(std::min<size_t>(names.size(), max_cities)), adjacent_(n_),
+	  stations_(n_), distances_(n_ * n_)
+{
+	std::unordered_map<std::string, int> ids;
+	for(int i = 0; i < n_; i++)
+		ids[names[i]] = i;
+
+	for(const auto &[from, to] : connections)
+	{
+		auto a = ids.find(from), b = ids.find(to);
+		if(a == ids.end() || b == ids.end() || a == b)
+			continue;
+
+		adjacent_[a->second].push_back(b->second);
+		adjacent_[b->second].push_back(a->second);
+	}
+
+	for(auto &neighbours : adjacent_)
+	{
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+						 neighbours.end());
+	}
+
+	std::vector<uint8_t> row(n_);
+	for(int from = 0; from < n_; from++)
+	{
+		search(from, row);
+		std::copy(row.begin(), row.end(), distances_.begin() + from * n_);
+	}
+}
+
+void RouteMap::add_station(int city)
+{
+	if(stations_[city])
+		return;
+
+	stations_[city] = true;
+	auto row = [this](int from) { return distances_.begin() + from * n_; };
+	std::vector<uint8_t> from_city(n_), from_other(n_);
+	for(int other = 0; other < n_; other++)
+	{
+		if(!stations_[other] || other == city)
+			continue;
+
+		// relax every pair through the new shuttle between them
+		std::copy(row(city), row(city) + n_, from_city.begin());
+		std::copy(row(other), row(other) + n_, from_other.begin());
+		for(int a = 0; a < n_; a++)
+		{
+			int to_city = from_city[a], to_other = from_other[a];
+			if(to_city == unreachable && to_other == unreachable)
+				continue;
+
+			auto distances = row(a);
+			for(int b = 0; b < n_; b++)
+			{
+				int via = std::min(to_city + 1 + from_other[b],
+								   to_other + 1 + from_city[b]);
+				if(via < distances[b])
+					distances[b] = via;
+			}
+		}
+	}
+}
+
+void RouteMap::remove_station(int city)
+{
+	if(!stations_[city])
+		return;
+
+	// only cities with a shortest route over one of its shuttles can change
+	std::vector<int> affected;
+	for(int a = 0; a < n_; a++)
+	{
+		const auto *row = &distances_[a * n_];
+		const auto *from_city = &distances_[city * n_];
+		bool shuttled = false;
+		for(int other = 0; other < n_ && !shuttled; other++)
+		{
+			if(!stations_[other] || other == city)
+				continue;
+
+			const auto *from_other = &distances_[other * n_];
+			for(int b = 0; b < n_ && !shuttled; b++)
+				shuttled = row[b] != unreachable &&
+					(row[city] + 1 + from_other[b] == row[b] ||
+					 row[other] + 1 + from_city[b] == row[b]);
+		}
+
+		if(shuttled)
+			affected.push_back(a);
+	}
+
+	stations_[city] = false;
+	std::vector<uint8_t> row(n_);
+	for(int a : affected)
+	{
+		search(a, row);
+		std::copy(row.begin(), row.end(), distances_.begin() + a * n_);
+	}
+}
+
+std::vector<int> RouteMap::route(int from, int to) const
+{
+	if(distance(from, to) == unreachable)
+		return {};
+
+	// step to any city a move closer until there
+	std::vector<int> ret = {from};
+	for(int city = from; city != to;)
+	{
+		int left = distance(city, to) - 1;
+		auto closer = [&](int next) { return distance(next, to) == left; };
+		auto next = std::find_if(adjacent_[city].begin(), adjacent_[city].end(),
+								 closer);
+		if(next != adjacent_[city].end())
+		{
+			city = *next;
+		}
+		else
+		{
+			for(int other = 0; other < n_; other++)
+				if(stations_[other] && closer(other))
+					city = other;
+		}
+		ret.push_back(city);
+	}
+
+	return ret;
+}
+
+bool RouteMap::stale() const
+{
+	std::vector<uint8_t> row(n_);
+	for(int from = 0; from < n_; from++)
+	{
+		search(from, row);
+		if(!std::equal(row.begin(), row.end(), distances_.begin() + from * n_))
+			return true;
+	}
+
+	return false;
+}
+
+void RouteMap::search(int from, std::vector<uint8_t> &row) const
+{
+	std::fill(row.begin(), row.end(), unreachable);
+	std::vector<int> queue = {from};
+	row[from] = 0;
+	bool shuttled = false;
+	for(size_t i = 0; i < queue.size(); i++)
+	{
+		int city = queue[i];
+		auto visit = [&](int next)
+		{
+			if(row[next] != unreachable)
+				return;
+			row[next] = row[city] + 1;
+			queue.push_back(next);
+		};
+
+		for(int next : adjacent_[city])
+			visit(next);
+
+		// the first station reached is the nearest, so it shuttles for all
+		if(stations_[city] && !shuttled)
+		{
+			shuttled = true;
+			for(int other = 0; other < n_; other++)
+				if(stations_[other])
+					visit(other);
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef PANDEMIC_ROUTES_HEADER_FILE
+#define PANDEMIC_ROUTES_HEADER_FILE
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using connections_t = std::vector<std::pair<std::string, std::string>>;
+
+// pairs of connected cities, one pair to a line
+connections_t load_connections(const std::string &filename);
+
+/* Travel distances between cities, in actions, driving along the map's
+ * connections or shuttling between research stations.
+ *
+ * Every pair's distance is kept in a dense table of bytes, a row per city,
+ * so a lookup is a single load. Building a station can only shorten routes,
+ * so the table is relaxed through the new shuttles. Removing one only
+ * searches again from the cities whose shortest routes used it.
+ */
+class RouteMap
+{
+public:
+	static constexpr int unreachable = 0xff;
+	// distances and the unreachable mark both fit a byte up to this many
+	static constexpr int max_cities = unreachable;
+
+	RouteMap() = default;
+	// cities are numbered by their place in names, which is sorted and no
+	// longer than max_cities
+	RouteMap(const std::vector<std::string> &names,
+			 const connections_t &connections);
+
+	bool empty() const { return n_ == 0; }
+	int size() const { return n_; }
+	int distance(int from, int to) const { return distances_[from * n_ + to]; }
+	const std::vector<int>& neighbours(int city) const { return adjacent_[city]; }
+	bool station(int city) const { return stations_[city]; }
+
+	void add_station(int city);
+	void remove_station(int city);
+
+	// a shortest route, both ends included, or nothing if there isn't one
+	std::vector<int> route(int from, int to) const;
+
+	// whether the table disagrees with distances worked out from scratch
+	bool stale() const;
+
+private:
+	// breadth first search for one city's row
+	void search(int from, std::vector<uint8_t> &row) const;
+
+	int n_ = 0;
+	std::vector<std::vector<int>> adjacent_;
+	std::vector<bool> stations_;
+	std::vector<uint8_t> distances_;
+};
+
+#endif
@@ -0,0 +1,595 @@
+#include "SelfPlay.hpp"
+#include "Hash.hpp"
+#include "Records.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <istream>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+
+	const char * outcomes[] = {
+		[game_record_t::WON] = "won",
+		[game_record_t::OUTBREAKS] = "outbreaks",
+		[game_record_t::CUBES] = "cubes",
+		[game_record_t::CARDS] = "cards"
+	};
+
+	const int epidemic_card = -1;
+	const int cubes_per_color = 24;
+	const int max_outbreaks = 8;
+	const int actions_per_turn = 4;
+
+	// what every game starts from
+	struct setup_t
+	{
+		std::vector<color_t> colors;
+		RouteMap routes;
+		int start = 0;
+		int initial_draws;
+		int epidemics;
+		int cards_per_epidemic;
+		int big_stacks;
+	};
+
+	class Game
+	{
+	public:
+		Game(const setup_t &setup, const policy_t &policy, std::mt19937_64 &rng,
+			 game_record_t &record);
+		void play();
+
+	private:
+		void infect(int city, color_t color, int cubes);
+		void draw();
+		void act(int player);
+		void discard(int player, size_t card);
+		// one move along a shortest route
+		void step(int player, int to);
+		int nearest_station(int city) const;
+		bool over() const { return over_; }
+		void lose(game_record_t::outcome_t outcome);
+
+		const setup_t &setup_;
+		const policy_t &policy_;
+		std::mt19937_64 &rng_;
+		game_record_t &record_;
+		game_record_t::turn_t *turn_ = nullptr;
+
+		RouteMap routes_;
+		// draw order, the next card at the back
+		std::vector<int> player_deck_;
+		std::vector<int> infection_deck_;
+		std::vector<int> infection_discard_;
+		std::vector<std::array<int, EVENT>> cubes_;
+		std::array<int, EVENT> supply_;
+		std::vector<std::vector<int>> hands_;
+		std::vector<int> positions_;
+		std::vector<int> stations_;
+		int epidemics_ = 0;
+		bool over_ = false;
+	};
+
+	Game::Game(const setup_t &setup, const policy_t &policy,
+			   std::mt19937_64 &rng, game_record_t &record)
+		: setup_(setup), policy_(policy), rng_(rng), record_(record),
+		  routes_(setup.routes), cubes_(setup.colors.size()),
+		  hands_(policy.players), positions_(policy.players, setup.start)
+	{
+		supply_.fill(cubes_per_color);
+		for(auto &cubes : cubes_)
+			cubes.fill(0);
+		for(int city = 0; city < routes_.size(); city++)
+			if(routes_.station(city))
+				stations_.push_back(city);
+
+		std::vector<int> cards(setup.colors.size());
+		for(size_t i = 0; i < cards.size(); i++)
+			cards[i] = i;
+		std::shuffle(cards.begin(), cards.end(), rng_);
+
+		record_.players = policy.players;
+		record_.hands.assign(policy.players, {});
+		for(int i = 0; i < setup.initial_draws && !cards.empty(); i++)
+		{
+			int player = i % policy.players;
+			hands_[player].push_back(cards.back());
+			record_.hands[player].push_back(cards.back());
+			cards.pop_back();
+		}
+
+		// the rest split into a pile per epidemic, the bigger piles on top
+		for(int pile = 0; pile < setup.epidemics; pile++)
+		{
+			int size = setup.cards_per_epidemic - 1 + (pile < setup.big_stacks);
+			size = std::min<int>(size, cards.size());
+			std::vector<int> stack(cards.end() - size, cards.end());
+			cards.resize(cards.size() - size);
+			stack.push_back(epidemic_card);
+			std::shuffle(stack.begin(), stack.end(), rng_);
+			player_deck_.insert(player_deck_.begin(), stack.begin(), stack.end());
+		}
+
+		for(size_t i = 0; i < setup.colors.size(); i++)
+			if(setup.colors[i] != EVENT)
+				infection_deck_.push_back(i);
+		std::shuffle(infection_deck_.begin(), infection_deck_.end(), rng_);
+
+		for(int cubes = 3; cubes > 0; cubes--)
+		{
+			for(int i = 0; i < 3 && !infection_deck_.empty(); i++)
+			{
+				int city = infection_deck_.back();
+				infection_deck_.pop_back();
+				record_.setup_infections.push_back(city);
+				infection_discard_.push_back(city);
+				infect(city, setup.colors[city], cubes);
+			}
+		}
+	}
+
+	void Game::play()
+	{
+		for(int player = 0; !over(); player = (player + 1) % policy_.players)
+		{
+			record_.turns.push_back({player + 1, {}, {}, {}, {}, {}});
+			turn_ = &record_.turns.back();
+
+			for(int action = 0; action < actions_per_turn && !over(); action++)
+				act(player);
+
+			for(int card = 0; card < 2 && !over(); card++)
+				draw();
+
+			auto &hand = hands_[player];
+			while(int(hand.size()) > policy_.hand_limit)
+			{
+				// let go of the color held least, cured ones first
+				std::array<int, EVENT + 1> held = {};
+				for(int card : hand)
+					held[setup_.colors[card]] +=
+						(record_.cures >> setup_.colors[card]) & 1? 0 : 1;
+				auto least = std::min_element(hand.begin(), hand.end(),
+					[&](int a, int b)
+					{
+						return held[setup_.colors[a]] < held[setup_.colors[b]];
+					});
+				discard(player, least - hand.begin());
+			}
+
+			for(int n = infection_rate(epidemics_); n > 0 && !over(); n--)
+			{
+				if(infection_deck_.empty())
+					break;
+
+				int city = infection_deck_.back();
+				infection_deck_.pop_back();
+				turn_->infections.push_back(city);
+				infection_discard_.push_back(city);
+				infect(city, setup_.colors[city], 1);
+			}
+		}
+	}
+
+	void Game::infect(int city, color_t color, int cubes)
+	{
+		std::vector<int> spreading;
+		std::vector<bool> outbroken(cubes_.size());
+		auto place = [&](int city, int n)
+		{
+			if(outbroken[city])
+				return;
+
+			auto &on_city = cubes_[city][color];
+			if(on_city + n > 3)
+			{
+				outbroken[city] = true;
+				spreading.push_back(city);
+			}
+			int placed = std::min(on_city + n, 3) - on_city;
+			on_city += placed;
+			supply_[color] -= placed;
+		};
+
+		place(city, cubes);
+		while(!spreading.empty() && !over())
+		{
+			int from = spreading.back();
+			spreading.pop_back();
+			if(++record_.outbreaks >= max_outbreaks)
+				lose(game_record_t::OUTBREAKS);
+			if(!routes_.empty())
+				for(int next : routes_.neighbours(from))
+					place(next, 1);
+		}
+
+		if(supply_[color] < 0)
+			lose(game_record_t::CUBES);
+	}
+
+	void Game::draw()
+	{
+		if(player_deck_.empty())
+		{
+			lose(game_record_t::CARDS);
+			return;
+		}
+
+		int card = player_deck_.back();
+		player_deck_.pop_back();
+		if(card != epidemic_card)
+		{
+			int player = turn_->player - 1;
+			turn_->draws.push_back(card);
+			hands_[player].push_back(card);
+			if(setup_.colors[card] == EVENT)
+				discard(player, hands_[player].size() - 1);
+			return;
+		}
+
+		epidemics_++;
+		if(infection_deck_.empty())
+			return;
+
+		int city = infection_deck_.front();
+		infection_deck_.erase(infection_deck_.begin());
+		turn_->epidemics.push_back(city);
+		infection_discard_.push_back(city);
+		infect(city, setup_.colors[city], 3);
+
+		std::shuffle(infection_discard_.begin(), infection_discard_.end(), rng_);
+		infection_deck_.insert(infection_deck_.end(), infection_discard_.begin(),
+							   infection_discard_.end());
+		infection_discard_.clear();
+	}
+
+	void Game::act(int player)
+	{
+		// without a map there's nowhere to go
+		if(routes_.empty())
+			return;
+
+		auto &hand = hands_[player];
+		int &position = positions_[player];
+
+		// cure as soon as the cards are in hand
+		std::array<int, EVENT + 1> held = {};
+		for(int card : hand)
+			held[setup_.colors[card]]++;
+		for(int color = 0; color < EVENT; color++)
+		{
+			if((record_.cures >> color) & 1 || held[color] < Tracker::cards_to_cure)
+				continue;
+
+			if(!routes_.station(position))
+			{
+				step(player, nearest_station(position));
+				return;
+			}
+
+			for(int n = Tracker::cards_to_cure; n > 0; n--)
+				discard(player, std::find_if(hand.begin(), hand.end(), [&](int card)
+					{
+						return setup_.colors[card] == color;
+					}) - hand.begin());
+			record_.cures |= 1 << color;
+			if(record_.cures == (1 << EVENT) - 1)
+				over_ = true;
+			return;
+		}
+
+		auto card = std::find(hand.begin(), hand.end(), position);
+		int nearest = nearest_station(position);
+		if(card != hand.end() && int(stations_.size()) < policy_.max_stations &&
+		   (nearest < 0 || routes_.distance(position, nearest) >= policy_.station_spacing))
+		{
+			turn_->stations.push_back(position);
+			stations_.push_back(position);
+			routes_.add_station(position);
+			discard(player, card - hand.begin());
+			return;
+		}
+
+		// the city worth the most cubes for the walk there
+		auto total = [this](int city)
+		{
+			int ret = 0;
+			for(int cubes : cubes_[city])
+				ret += cubes;
+			return ret;
+		};
+
+		int target = -1;
+		double best = 0.0;
+		for(int city = 0; city < int(cubes_.size()); city++)
+		{
+			int cubes = total(city);
+			int distance = routes_.distance(position, city);
+			if(cubes == 0 || distance == RouteMap::unreachable ||
+			   (cubes < policy_.treat_at && city != position))
+				continue;
+
+			double score = cubes - policy_.distance_weight * distance;
+			if(target < 0 || score > best)
+			{
+				target = city;
+				best = score;
+			}
+		}
+
+		if(target >= 0 && target != position)
+		{
+			step(player, target);
+		}
+		else if(target == position)
+		{
+			auto &cubes = cubes_[position];
+			int color = std::max_element(cubes.begin(), cubes.end()) - cubes.begin();
+			int treated = (record_.cures >> color) & 1? cubes[color] : 1;
+			cubes[color] -= treated;
+			supply_[color] += treated;
+		}
+	}
+
+	void Game::discard(int player, size_t card)
+	{
+		auto &hand = hands_[player];
+		turn_->discards.push_back(hand[card]);
+		hand.erase(hand.begin() + card);
+	}
+
+	void Game::step(int player, int to)
+	{
+		int &position = positions_[player];
+		int left = routes_.distance(position, to);
+		if(to < 0 || left == 0 || left == RouteMap::unreachable)
+			return;
+
+		for(int next : routes_.neighbours(position))
+		{
+			if(routes_.distance(next, to) < left)
+			{
+				position = next;
+				return;
+			}
+		}
+
+		if(routes_.station(position))
+		{
+			for(int station : stations_)
+			{
+				if(routes_.distance(station, to) < left)
+				{
+					position = station;
+					return;
+				}
+			}
+		}
+	}
+
+	int Game::nearest_station(int city) const
+	{
+		int ret = -1;
+		for(int station : stations_)
+			if(ret < 0 || routes_.distance(city, station) < routes_.distance(city, ret))
+				ret = station;
+		return ret;
+	}
+
+	void Game::lose(game_record_t::outcome_t outcome)
+	{
+		if(!over_)
+			record_.outcome = outcome;
+		over_ = true;
+	}
+
+	int read_u8(std::istream &in)
+	{
+		return in.get();
+	}
+
+	bool read_list(std::istream &in, std::vector<int> &list)
+	{
+		int n = read_u8(in);
+		list.clear();
+		for(int i = 0; i < n && in; i++)
+			list.push_back(read_u8(in));
+		return bool(in);
+	}
+
+	std::string join(const Tracker &tracker, const std::vector<int> &cards)
+	{
+		std::string ret;
+		for(int card : cards)
+			ret += " " + std::next(tracker.cities().begin(), card)->first;
+		return ret;
+	}
+
+}  /* namespace  */
+
+bool set_policy(policy_t &policy, const std::string &name, double value)
+{
+	// NaN fails every comparison, and a whole number in range converts exactly
+	auto whole = [value](int min, int max)
+	{
+		return value >= min && value <= max && value == std::floor(value);
+	};
+
+	if(name == "players" && whole(policy_t::min_players, policy_t::max_players))
+		policy.players = int(value);
+	else if(name == "treat_at" && whole(0, policy_t::max_cubes))
+		policy.treat_at = int(value);
+	else if(name == "distance_weight" && std::isfinite(value) && value >= 0.0)
+		policy.distance_weight = value;
+	else if(name == "station_spacing" && whole(1, RouteMap::max_cities))
+		policy.station_spacing = int(value);
+	else if(name == "max_stations" && whole(0, policy_t::stations))
+		policy.max_stations = int(value);
+	else if(name == "hand_limit" &&
+			whole(Tracker::cards_to_cure, RouteMap::max_cities))
+		policy.hand_limit = int(value);
+	else
+		return false;
+
+	return true;
+}
+
+std::string outcome_to_string(game_record_t::outcome_t outcome)
+{
+	return outcomes[static_cast<int>(outcome)];
+}
+
+bool read_game(std::istream &in, game_record_t &game)
+{
+	while(in)
+	{
+		int type = read_u8(in);
+		int length = read_u8(in);
+		length |= read_u8(in) << 8;
+		if(!in)
+			return false;
+		if(type != RecordWriter::GAME)
+		{
+			in.ignore(length);
+			continue;
+		}
+
+		game = {};
+		for(int byte = 0; byte < 4; byte++)
+			game.game |= uint32_t(read_u8(in)) << (8 * byte);
+		game.players = read_u8(in);
+		game.outcome = game_record_t::outcome_t(
+			std::min<int>(read_u8(in), game_record_t::N_OUTCOMES - 1));
+		game.cures = read_u8(in);
+		game.outbreaks = read_u8(in);
+		int n_turns = read_u8(in);
+		n_turns |= read_u8(in) << 8;
+		read_list(in, game.setup_infections);
+		game.hands.resize(game.players);
+		for(auto &hand : game.hands)
+			read_list(in, hand);
+		for(int i = 0; i < n_turns && in; i++)
+		{
+			game_record_t::turn_t turn;
+			turn.player = read_u8(in);
+			for(auto *list : {&turn.stations, &turn.draws, &turn.epidemics,
+							  &turn.infections, &turn.discards})
+				read_list(in, *list);
+			game.turns.push_back(std::move(turn));
+		}
+
+		return bool(in);
+	}
+
+	return false;
+}
+
+std::vector<std::string> game_commands(const Tracker &tracker,
+									   const game_record_t &game)
+{
+	std::vector<std::string> ret = {"infect" + join(tracker, game.setup_infections)};
+	for(size_t player = 0; player < game.hands.size(); player++)
+		ret.push_back("draw " + std::to_string(player + 1) +
+					  join(tracker, game.hands[player]));
+
+	for(const auto &turn : game.turns)
+	{
+		if(!turn.stations.empty())
+			ret.push_back("station" + join(tracker, turn.stations));
+
+		if(turn.draws.size() + turn.epidemics.size() == Tracker::cards_per_turn)
+		{
+			auto command = "turn " + std::to_string(turn.player) +
+				join(tracker, turn.draws);
+			for(int card : turn.epidemics)
+				command += " epidemic" + join(tracker, {card});
+			if(!turn.infections.empty())
+				command += " infect" + join(tracker, turn.infections);
+			ret.push_back(std::move(command));
+		}
+		else
+		{
+			// a game over partway through the draws, which a turn won't take,
+			// goes in card by card, and one won before them not at all
+			if(!turn.draws.empty())
+				ret.push_back("draw " + std::to_string(turn.player) +
+							  join(tracker, turn.draws));
+			for(int card : turn.epidemics)
+				ret.push_back("epidemic" + join(tracker, {card}));
+			if(!turn.infections.empty())
+				ret.push_back("infect" + join(tracker, turn.infections));
+		}
+
+		if(!turn.discards.empty())
+			ret.push_back("discard" + join(tracker, turn.discards));
+	}
+
+	return ret;
+}
+
+self_play_stats_t self_play(const Tracker &setup, const policy_t &policy,
+							long games, uint64_t seed,
+							const std::function<void(const game_record_t &)> &record)
+{
+	setup_t start;
+	for(const auto &card : setup.cities())
+		start.colors.push_back(card.second);
+	start.initial_draws = setup.initial_draws();
+	start.epidemics = setup.epidemics();
+	start.cards_per_epidemic = setup.cards_per_epidemic();
+	start.big_stacks = setup.big_stacks();
+
+	// every game starts with only Atlanta's station
+	start.routes = setup.routes();
+	for(int city = 0; city < start.routes.size(); city++)
+		start.routes.remove_station(city);
+	if(auto atlanta = setup.resolve("Atlanta"); atlanta.status == Tracker::OK)
+	{
+		start.start = setup.index(*atlanta.card);
+		if(!start.routes.empty())
+			start.routes.add_station(start.start);
+	}
+
+	self_play_stats_t stats;
+	std::mutex mutex;
+	std::atomic<long> next{0};
+	auto worker = [&]()
+	{
+		self_play_stats_t local;
+		game_record_t game;
+		for(long i; (i = next++) < games;)
+		{
+			std::mt19937_64 rng(mix64(seed ^ mix64(i)));
+			game = {};
+			game.game = i;
+			Game(start, policy, rng, game).play();
+
+			local.games++;
+			local.turns += game.turns.size();
+			local.outcomes[game.outcome]++;
+			if(record)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				record(game);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.games += local.games;
+		stats.turns += local.turns;
+		for(int i = 0; i < game_record_t::N_OUTCOMES; i++)
+			stats.outcomes[i] += local.outcomes[i];
+	};
+
+	std::vector<std::thread> threads;
+	for(unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++)
+		threads.emplace_back(worker);
+	for(auto &thread : threads)
+		thread.join();
+
+	return stats;
+}
@@ -0,0 +1,104 @@
+#ifndef PANDEMIC_SELF_PLAY_HEADER_FILE
+#define PANDEMIC_SELF_PLAY_HEADER_FILE
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "Tracker.hpp"
+
+/* Knobs for the self-play bot. Each action a player cures if it can, heads
+ * for a station to cure if it holds the cards, builds a station where there
+ * isn't one near, and otherwise treats the city that's worth the most cubes
+ * for the walk.
+ */
+struct policy_t
+{
+	// the game takes two to four players
+	static const int min_players = 2;
+	static const int max_players = 4;
+	int players = 4;
+	// a city holds up to three cubes of each color
+	static const int max_cubes = 3 * EVENT;
+	// the box has six research stations
+	static const int stations = 6;
+	// fewest cubes on a city worth going out of the way to treat
+	int treat_at = 2;
+	// cubes a move is worth when weighing where to go
+	double distance_weight = 1.0;
+	// build a station when the nearest is at least this many moves away
+	int station_spacing = 4;
+	int max_stations = stations;
+	int hand_limit = 7;
+};
+
+// sets a policy_t field by name, false if there's no such field or the value
+// is out of its range: whole numbers for the counts, from 1 move for the
+// spacing and up to a route table's cities for it and the hand, a cure's
+// worth of cards in a hand, and a weight that's finite and not negative
+bool set_policy(policy_t &policy, const std::string &name, double value);
+
+/* A played game as the commands the tracker would have logged, cities
+ * numbered by Tracker::index().
+ */
+struct game_record_t
+{
+	enum outcome_t {WON = 0, OUTBREAKS, CUBES, CARDS, N_OUTCOMES};
+
+	struct turn_t
+	{
+		// players are numbered from 1
+		int player;
+		std::vector<int> stations;
+		std::vector<int> draws;
+		// the bottom cards the epidemics infected
+		std::vector<int> epidemics;
+		std::vector<int> infections;
+		// for cures and the hand limit, and events, which the bot never plays
+		std::vector<int> discards;
+	};
+
+	uint32_t game = 0;
+	int players = 0;
+	outcome_t outcome = WON;
+	// bit per color
+	int cures = 0;
+	int outbreaks = 0;
+	// top card first
+	std::vector<int> setup_infections;
+	// cards dealt to each player
+	std::vector<std::vector<int>> hands;
+	std::vector<turn_t> turns;
+};
+
+std::string outcome_to_string(game_record_t::outcome_t outcome);
+
+// reads the next game from binary records, skipping any other records
+bool read_game(std::istream &in, game_record_t &game);
+
+// the commands that log a game into a fresh tracker set up like the one it
+// was played from
+std::vector<std::string> game_commands(const Tracker &tracker,
+									   const game_record_t &game);
+
+struct self_play_stats_t
+{
+	long games = 0;
+	long turns = 0;
+	std::array<long, game_record_t::N_OUTCOMES> outcomes = {};
+};
+
+/* Plays games from the start of the game the tracker is set up for, using
+ * its cities, map, deal and epidemics, on every core. Each game is played
+ * from its own seed, so game n of a seed always goes the same way. Finished
+ * games are handed to record one at a time, in no particular order.
+ */
+self_play_stats_t self_play(const Tracker &setup, const policy_t &policy,
+							long games, uint64_t seed,
+							const std::function<void(const game_record_t &)> &record
+								= nullptr);
+
+#endif
@@ -0,0 +1,323 @@
+#include "Simulation.hpp"
+#include "Cache.hpp"
+#include "Hash.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+	const char * queries[] = {
+		[InfectionSampler::ANY_OUTBREAK] = "any_outbreak",
+		[InfectionSampler::OUTBREAKS] = "outbreaks",
+		[InfectionSampler::INFECTED] = "infected"
+	};
+
+	// too few samples and a rare event looks like it never happens
+	const long min_samples = 1000;
+	// samples a thread takes between merging into the total
+	const int batch = 64;
+	const auto progress_interval = std::chrono::milliseconds(20);
+
+}  /* namespace  */
+
+std::string query_to_string(InfectionSampler::query_t query)
+{
+	return queries[static_cast<int>(query)];
+}
+
+InfectionSampler::query_t to_query(const std::string &str)
+{
+	for(int i = 0; i < InfectionSampler::N_QUERIES; i++)
+		if(str == queries[i]) return static_cast<InfectionSampler::query_t>(i);
+
+	return InfectionSampler::N_QUERIES;
+}
+
+void estimate_t::add(double x)
+{
+	samples++;
+	double delta = x - mean;
+	mean += delta / samples;
+	m2 += delta * (x - mean);
+}
+
+void estimate_t::merge(const estimate_t &other)
+{
+	if(other.samples == 0)
+		return;
+
+	long n = samples + other.samples;
+	double delta = other.mean - mean;
+	mean += delta * other.samples / n;
+	m2 += other.m2 + delta * delta * samples * other.samples / n;
+	samples = n;
+}
+
+double estimate_t::variance() const
+{
+	return samples > 1? m2 / (samples - 1) : 0.0;
+}
+
+double estimate_t::half_width() const
+{
+	if(samples == 0)
+		return std::numeric_limits<double>::infinity();
+
+	return 1.96 * std::sqrt(variance() / samples);
+}
+
+estimate_t estimate(const sampler_t &sample, std::chrono::duration<double> budget,
+					double precision, const progress_t &progress,
+					estimate_t prior)
+{
+	using clock = std::chrono::steady_clock;
+	budget = std::min(budget, std::chrono::duration<double>(3600.0));
+	const auto start = clock::now();
+	const auto deadline =
+		start + std::chrono::duration_cast<clock::duration>(budget);
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::atomic<bool> stop{false};
+	estimate_t total = prior;
+	auto precise = [&]()
+	{
+		return precision > 0.0 && total.samples >= min_samples &&
+			total.half_width() <= precision;
+	};
+
+	if(precise())
+		return total;
+
+	auto worker = [&](uint64_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		while(!stop)
+		{
+			estimate_t local;
+			for(int i = 0; i < batch; i++)
+				local.add(sample(rng));
+
+			std::lock_guard<std::mutex> lock(mutex);
+			total.merge(local);
+			if(precise())
+			{
+				stop = true;
+				wake.notify_one();
+			}
+		}
+	};
+
+	std::random_device seeds;
+	std::vector<std::thread> threads;
+	for(unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++)
+		threads.emplace_back(worker, (uint64_t(seeds()) << 32) ^ seeds());
+
+	std::unique_lock<std::mutex> lock(mutex);
+	auto next_progress = start + progress_interval;
+	while(!stop)
+	{
+		wake.wait_until(lock, std::min(deadline, next_progress),
+						[&stop] { return stop.load(); });
+
+		auto now = clock::now();
+		if(now >= deadline)
+			stop = true;
+
+		if(progress && !stop && now >= next_progress)
+		{
+			auto partial = total;
+			lock.unlock();
+			progress(partial);
+			lock.lock();
+			next_progress = now + progress_interval;
+		}
+	}
+	lock.unlock();
+
+	for(auto &thread : threads)
+		thread.join();
+
+	return total;
+}
+
+InfectionSampler::InfectionSampler(const Tracker &tracker, query_t query,
+								   int turns, const card_t *city)
+	: query_(query), turns_(turns), city_(-1),
+	  n_draws_(tracker.n_draws()), epidemics_(tracker.current_epidemics())
+{
+	std::unordered_map<std::string, int> ids;
+	for(const auto &card : tracker.cities())
+	{
+		int id = cubes_.size();
+		ids[card.first] = id;
+		cubes_.push_back(std::min(tracker.cubes(card.first), 3));
+		if(city && card.first == city->first)
+			city_ = id;
+	}
+
+	const auto &routes = tracker.routes();
+	for(int id = 0; id < routes.size(); id++)
+		neighbours_.push_back(routes.neighbours(id));
+
+	auto to_ids = [&ids](const deck_t &pile)
+	{
+		std::vector<int> ret;
+		for(const auto &card : pile)
+			ret.push_back(ids.at(card.first));
+		return ret;
+	};
+
+	for(const auto &stratum : tracker.infection_deck())
+		strata_.push_back(to_ids(stratum));
+	unknowns_ = tracker.unknown_infects();
+	discard_ = to_ids(tracker.infection_discard());
+
+	// each epidemic left is equally likely anywhere in its window
+	for(int e = tracker.current_epidemics(); e < tracker.epidemics(); e++)
+	{
+		auto [safe_phase, next_phase] = tracker.epidemic_window(e);
+		int first = std::max(safe_phase, n_draws_);
+		windows_.emplace_back(first, std::max(next_phase, first + 1));
+	}
+
+	key_ = mix64(tracker.state_hash() ^ mix64(query));
+	key_ = mix64(key_ ^ mix64(turns));
+	key_ = mix64(key_ ^ mix64(city_ + 1));
+	key_ = mix64(key_ ^ mix64(neighbours_.size()));
+}
+
+double InfectionSampler::operator() (std::mt19937_64 &rng) const
+{
+	auto strata = strata_;
+	auto discard = discard_;
+	auto cubes = cubes_;
+	auto roll = [&rng](size_t n) { return size_t(rng() % n); };
+
+	// settle which of the listed cards were really infected unseen
+	for(size_t i = 0; i < strata.size(); i++)
+	{
+		auto &stratum = strata[i];
+		for(int k = 0; k < unknowns_[i]; k++)
+		{
+			std::swap(stratum[k], stratum[k + roll(stratum.size() - k)]);
+			discard.push_back(stratum[k]);
+		}
+		stratum.erase(stratum.begin(), stratum.begin() + unknowns_[i]);
+	}
+	strata.erase(std::remove_if(strata.begin(), strata.end(),
+								[](const auto &stratum) { return stratum.empty(); }),
+				 strata.end());
+
+	std::vector<int> epidemic_draws;
+	for(const auto &[first, last] : windows_)
+		epidemic_draws.push_back(first + 1 + roll(last - first));
+
+	// strata are unordered, so the next card is any in the top one
+	auto take = [&roll](std::vector<int> &stratum)
+	{
+		size_t i = roll(stratum.size());
+		int card = stratum[i];
+		stratum[i] = stratum.back();
+		stratum.pop_back();
+		return card;
+	};
+
+	int outbreaks = 0;
+	bool infected = false;
+	std::vector<int> spreading;
+	const std::vector<int> no_neighbours;
+	std::vector<bool> outbroken(neighbours_.empty()? 0 : cubes.size());
+	// a city breaks out at most once a chain, and takes no more cubes after
+	auto place = [&](int city, int n)
+	{
+		if(!outbroken.empty() && outbroken[city])
+			return;
+
+		infected |= city == city_;
+		if(cubes[city] + n > 3)
+		{
+			spreading.push_back(city);
+			if(!outbroken.empty())
+				outbroken[city] = true;
+		}
+		cubes[city] = std::min(cubes[city] + n, 3);
+	};
+
+	// outbreaks spread to the neighbours
+	auto infect = [&](int card, int n)
+	{
+		discard.push_back(card);
+		place(card, n);
+		while(!spreading.empty())
+		{
+			int city = spreading.back();
+			spreading.pop_back();
+			outbreaks++;
+			for(int next : neighbours_.empty()? no_neighbours : neighbours_[city])
+				place(next, 1);
+		}
+		std::fill(outbroken.begin(), outbroken.end(), false);
+	};
+
+	int n_draws = n_draws_;
+	int epidemics = epidemics_;
+	for(int turn = 0; turn < turns_ && !strata.empty(); turn++)
+	{
+		for(int draw = 0; draw < 2; draw++)
+		{
+			if(std::find(epidemic_draws.begin(), epidemic_draws.end(),
+						 ++n_draws) == epidemic_draws.end())
+				continue;
+
+			epidemics++;
+			infect(take(strata.front()), 3);
+			if(strata.front().empty())
+				strata.erase(strata.begin());
+			strata.push_back(std::move(discard));
+			discard.clear();
+		}
+
+		for(int n = infection_rate(epidemics); n > 0 && !strata.empty(); n--)
+		{
+			infect(take(strata.back()), 1);
+			if(strata.back().empty())
+				strata.pop_back();
+		}
+	}
+
+	switch(query_)
+	{
+	case ANY_OUTBREAK:
+		return outbreaks > 0;
+	case OUTBREAKS:
+		return outbreaks;
+	case INFECTED:
+		return infected;
+	default:
+		return 0.0;
+	}
+}
+
+estimate_t simulate(const Tracker &tracker, const InfectionSampler &sampler,
+					std::chrono::duration<double> budget, double precision,
+					const progress_t &progress)
+{
+	auto &cache = tracker.cache();
+	estimate_t prior;
+	if(auto cached = cache.find<estimate_t>(ResultCache::SIMULATION,
+											sampler.key()))
+		prior = *cached;
+
+	auto ret = estimate([&sampler](std::mt19937_64 &rng) { return sampler(rng); },
+						budget, precision, progress, prior);
+	cache.insert(ResultCache::SIMULATION, sampler.key(), ret);
+	return ret;
+}
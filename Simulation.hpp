@@ -0,0 +1,90 @@
+#ifndef PANDEMIC_SIMULATION_HEADER_FILE
+#define PANDEMIC_SIMULATION_HEADER_FILE
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+
+#include "Tracker.hpp"
+
+/* Running mean and variance of a sampled quantity (Welford), which merge so
+ * threads can sample apart and an estimate can be picked up again later.
+ */
+struct estimate_t
+{
+	long samples = 0;
+	double mean = 0.0;
+	// sum of squared differences from the mean
+	double m2 = 0.0;
+
+	void add(double x);
+	void merge(const estimate_t &other);
+	double variance() const;
+	// half the width of the 95% confidence interval around the mean
+	double half_width() const;
+};
+
+using sampler_t = std::function<double(std::mt19937_64 &)>;
+using progress_t = std::function<void(const estimate_t &)>;
+
+/* Anytime Monte Carlo estimator.
+ *
+ * Samples on every core, starting from prior, until the budget is spent or
+ * the confidence interval is within precision either side of the mean. Every
+ * progress_interval the running estimate is handed to progress, from the
+ * calling thread. A precision of 0 spends the whole budget.
+ */
+estimate_t estimate(const sampler_t &sample, std::chrono::duration<double> budget,
+					double precision, const progress_t &progress = nullptr,
+					estimate_t prior = {});
+
+/* Plays out the infection deck from the tracked state: each turn draws two
+ * player cards, any of them an epidemic as its window allows, then infects at
+ * the current rate. Cards infected unseen are drawn at random from their
+ * strata for each sample. Cube counts come from the logged infections, and
+ * outbreaks chain along the map's connections once the tracker has them.
+ */
+class InfectionSampler
+{
+public:
+	enum query_t {ANY_OUTBREAK = 0, OUTBREAKS, INFECTED, N_QUERIES};
+
+	// city is the card INFECTED asks about
+	InfectionSampler(const Tracker &tracker, query_t query, int turns,
+					 const card_t *city = nullptr);
+
+	double operator() (std::mt19937_64 &rng) const;
+
+	// identifies the state and query, for caching estimates
+	uint64_t key() const { return key_; }
+
+private:
+	query_t query_;
+	int turns_;
+	int city_;
+	uint64_t key_;
+
+	// cards are numbered by their place in the cities
+	std::vector<std::vector<int>> strata_;
+	std::vector<int> unknowns_;
+	std::vector<int> discard_;
+	std::vector<int> cubes_;
+	std::vector<std::vector<int>> neighbours_;
+	std::vector<std::pair<int, int>> windows_;
+	int n_draws_;
+	int epidemics_;
+};
+
+// names used by the front end and the C API
+std::string query_to_string(InfectionSampler::query_t query);
+InfectionSampler::query_t to_query(const std::string &str);
+
+/* Estimates a query against the tracked state, carrying on from any earlier
+ * estimate of it in the tracker's result cache and leaving the new one there.
+ */
+estimate_t simulate(const Tracker &tracker, const InfectionSampler &sampler,
+					std::chrono::duration<double> budget, double precision,
+					const progress_t &progress = nullptr);
+
+#endif
@@ -0,0 +1,1483 @@
+#include "Tracker.hpp"
+#include "Cache.hpp"
+#include "Hash.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <cctype>
+#include <cmath>
+#include <set>
+
+namespace {
+
+	const char * colors[] = {
+		[YELLOW] = "yellow",
+		[RED] = "red",
+		[BLUE] = "blue",
+		[BLACK] = "black",
+		[EVENT] = "event"
+	};
+
+	const char * piles[] = {
+		[PLAYER_DECK] = "player_deck",
+		[PLAYER_DRAWN] = "player_drawn",
+		[INFECTION_DISCARD] = "infection_discard",
+		[INFECTION_REMOVED] = "infection_removed",
+		[INFECTION_DECK] = "infection_deck"
+	};
+
+}  /* namespace  */
+
+bool operator== (const LazyString &lhs, const LazyString &rhs)
+{
+	for(int i = 0; i < std::min(lhs.size(), rhs.size()); i++)
+		if(tolower(lhs[i]) != tolower(rhs[i])) return false;
+	
+	return true;
+}
+
+bool operator< (const LazyString &lhs, const LazyString &rhs)
+{
+	for(int i = 0; i < std::min(lhs.size(), rhs.size()); i++)
+	{
+		if(tolower(lhs[i]) < tolower(rhs[i])) return true;
+		else if(tolower(lhs[i]) > tolower(rhs[i])) return false;
+	}
+	
+	return false;
+}
+
+deck_t load_cities(const std::string &filename)
+{
+	std::ifstream in(filename);
+	deck_t ret;
+	
+	for(std::istream_iterator<std::string> it(in);
+		it != std::istream_iterator<std::string>(); ++it)
+	{
+		auto key = *it++;
+		ret.insert(std::make_pair(std::move(key), to_color(*it)));
+	}
+	
+	return ret;
+}
+
+color_t to_color(const std::string &str)
+{
+	for(int i = 0; i < N_COLORS; i++)
+		if(str == colors[i]) return static_cast<color_t>(i);
+	
+	return N_COLORS;
+}
+
+std::string color_to_string(color_t color)
+{
+	return colors[static_cast<int>(color)];
+}
+
+std::string pile_to_string(pile_t pile)
+{
+	return piles[static_cast<int>(pile)];
+}
+
+/* Places a card can be for hashing, on from the piles in pile_t. Strata are
+ * numbered from the bottom so the ones underneath keep their keys as cards
+ * are infected off the top.
+ */
+const int hand_place = N_PILES;
+const int cube_place = 1 << 16;
+const int station_place = 1 << 18;
+const int stratum_place = 1 << 20;
+static_assert(hand_place + Tracker::max_player < cube_place,
+			  "hands' keys run into the cubes'");
+
+/* Forecast risk engine.
+ * 
+ * Scores where the cards we know about will end up over the next
+ * risk_horizon turns. Infecting a city costs one more than the cubes already
+ * logged against it (capped at 3), and an outbreak costs outbreak_cost.
+ * Turn 0 is the infect step of the current turn, so its player draws are
+ * assumed to be done already.
+ */
+const int risk_horizon = Tracker::risk_horizon;
+const double outbreak_cost = 10.0;
+
+int infection_rate(int epidemics)
+{
+	static const int track[] = {2, 2, 2, 3, 3, 4, 4};
+	return track[std::min(epidemics, 6)];
+}
+
+namespace {
+
+	double infection_cost(int cubes)
+	{
+		return cubes >= 3? outbreak_cost : 1.0 + cubes;
+	}
+
+	double log_choose(int n, int k)
+	{
+		return std::lgamma(n + 1.0) - std::lgamma(k + 1.0) - std::lgamma(n - k + 1.0);
+	}
+
+	// chance of exactly k cards of a color in drawn draws from a deck
+	double draw_pmf(int deck, int color, int drawn, int k)
+	{
+		if(k < 0 || k > color || k > drawn || drawn - k > deck - color)
+			return 0.0;
+		
+		return std::exp(log_choose(color, k) + log_choose(deck - color, drawn - k)
+						- log_choose(deck, drawn));
+	}
+
+	// chance of at least wanted cards of a color in drawn draws from a deck
+	double draw_odds(int deck, int color, int drawn, int wanted)
+	{
+		if(wanted <= 0)
+			return 1.0;
+		
+		double odds = 0.0;
+		for(int k = wanted; k <= std::min(color, drawn); k++)
+			odds += draw_pmf(deck, color, drawn, k);
+		
+		return odds;
+	}
+
+}  /* namespace  */
+
+struct risk_model_t
+{
+	// chance that the next epidemic is drawn before turn t's infections
+	std::vector<double> epidemic_odds;
+	int rate;
+	int epidemic_rate;
+	int discard_size;
+	
+	// risk of a card placed at position (0 = top) of the infection deck
+	double forecast_risk(int position, int cubes) const
+	{
+		double risk = 0.0, no_epidemic = 1.0;
+		for(int e = 0; e < risk_horizon; e++)
+		{
+			double odds = epidemic_odds[e];
+			if(odds == 0.0) continue;
+			no_epidemic -= odds;
+			
+			// everything infected before the epidemic gets shuffled back on top
+			int before = e * rate;
+			int pile = discard_size + before + 1;
+			int after = (risk_horizon - e) * epidemic_rate;
+			
+			double cost = 0.0;
+			if(position < before)
+				cost = infection_cost(cubes) +
+					std::min(1.0, double(after) / pile) * infection_cost(cubes + 1);
+			else if(position - before < after - pile)
+				cost = infection_cost(cubes);
+			
+			risk += odds * cost;
+		}
+		
+		if(position < risk_horizon * rate)
+			risk += no_epidemic * infection_cost(cubes);
+		
+		return risk;
+	}
+	
+	// risk of a card sitting in the infection discard
+	double discard_risk(int cubes) const
+	{
+		double risk = 0.0;
+		for(int e = 0; e < risk_horizon; e++)
+		{
+			int pile = discard_size + e * rate + 1;
+			int after = (risk_horizon - e) * epidemic_rate;
+			risk += epidemic_odds[e] * std::min(1.0, double(after) / pile) *
+				infection_cost(cubes);
+		}
+		
+		return risk;
+	}
+};
+
+namespace {
+
+	struct ranked_order_t
+	{
+		double risk;
+		std::vector<int> order;
+	};
+
+	/* Ranks every ordering of the cards given cost[card][position], keeping the
+	 * best few. Branches on the top card in parallel and prunes any partial
+	 * ordering that can't beat the worst one kept.
+	 */
+	std::vector<ranked_order_t> rank_orderings(
+		const std::vector<std::vector<double>> &cost, size_t keep)
+	{
+		const int n = cost.size();
+		if(keep == 0)
+			return {};
+		
+		auto keep_best = [keep](std::vector<ranked_order_t> &best, ranked_order_t r)
+		{
+			auto pos = std::upper_bound(best.begin(), best.end(), r,
+				[](const auto &a, const auto &b) { return a.risk < b.risk; });
+			best.insert(pos, std::move(r));
+			if(best.size() > keep)
+				best.pop_back();
+		};
+		
+		auto search = [&](int top)
+		{
+			std::vector<ranked_order_t> best;
+			std::vector<int> order{top};
+			std::vector<bool> used(n);
+			used[top] = true;
+			
+			std::function<void(double)> branch = [&](double risk)
+			{
+				const int position = order.size();
+				if(position == n)
+				{
+					keep_best(best, {risk, order});
+					return;
+				}
+				
+				// each card left at its cheapest free position is a lower bound
+				double bound = risk;
+				for(int c = 0; c < n; c++)
+					if(!used[c])
+						bound += *std::min_element(cost[c].begin() + position,
+												   cost[c].end());
+				if(best.size() == keep && bound >= best.back().risk)
+					return;
+				
+				for(int c = 0; c < n; c++)
+				{
+					if(used[c]) continue;
+					used[c] = true;
+					order.push_back(c);
+					branch(risk + cost[c][position]);
+					order.pop_back();
+					used[c] = false;
+				}
+			};
+			
+			branch(cost[top][0]);
+			return best;
+		};
+		
+		std::vector<std::future<std::vector<ranked_order_t>>> tasks;
+		for(int top = 0; top < n; top++)
+			tasks.push_back(std::async(std::launch::async, search, top));
+		
+		std::vector<ranked_order_t> ret;
+		for(auto &task : tasks)
+			for(auto &r : task.get())
+				keep_best(ret, std::move(r));
+		
+		return ret;
+	}
+
+}  /* namespace  */
+
+Tracker::Tracker(deck_t cities, const std::vector<std::string> &events,
+				 int initial_draws, int epidemics)
+	: cities_(std::move(cities)), infection_deck_{cities_}, unknown_infects_{0},
+	  initial_draws_(initial_draws), epidemics_(epidemics),
+	  n_draws_(-initial_draws)
+{
+	for(const auto &event : events)
+		cities_.insert(std::make_pair(event, EVENT));
+	
+	player_deck_ = cities_;
+	for(const auto &card : player_deck_)
+		++deck_counts_[card.second];
+	total_cards_ = cities_.size() - initial_draws + epidemics;
+	cards_per_epidemic_ = total_cards_ / epidemics;
+	big_stacks_ = total_cards_ - cards_per_epidemic_ * epidemics;
+	hash_ = pile_hash();
+	cache_ = std::make_shared<ResultCache>();
+	cure_cache_ = std::make_shared<cure_cache_t>();
+}
+
+std::pair<deck_t::const_iterator, deck_t::const_iterator>
+	Tracker::matches(const std::string &name) const
+{
+	return cities_.equal_range(name);
+}
+
+Tracker::result_t Tracker::resolve(const std::string &name) const
+{
+	auto range = matches(name);
+	switch(std::distance(range.first, range.second))
+	{
+	case 0:
+		return {INVALID, nullptr};
+	case 1:
+		return {OK, &*range.first};
+	default:
+		return {AMBIGUOUS, nullptr};
+	}
+}
+
+Tracker::result_t Tracker::draw(const std::string &name)
+{
+	auto ret = resolve(name);
+	return ret.status == OK? draw(*ret.card) : ret;
+}
+
+Tracker::result_t Tracker::draw(const card_t &city)
+{
+	result_t ret = {OK, &city};
+	
+	auto card = player_deck_.find(ret.card->first);
+	if(card == player_deck_.end())
+		return {NOT_IN_PILE, ret.card};
+	
+	toggle(card->first, PLAYER_DECK);
+	toggle(card->first, PLAYER_DRAWN);
+	player_drawn_.insert(*card);
+	--deck_counts_[card->second];
+	player_deck_.erase(card);
+	n_draws_++;
+	settle_draws();
+	return ret;
+}
+
+Tracker::result_t Tracker::undraw(const std::string &name)
+{
+	auto ret = resolve(name);
+	if(ret.status != OK)
+		return ret;
+	
+	auto card = player_drawn_.find(ret.card->first);
+	if(card == player_drawn_.end())
+		return {NOT_IN_PILE, ret.card};
+	
+	for(auto &hand : hands_)
+		if(hand.second.erase(card->first))
+			toggle(card->first, hand_place + hand.first);
+	toggle(card->first, PLAYER_DRAWN);
+	toggle(card->first, PLAYER_DECK);
+	player_deck_.insert(*card);
+	++deck_counts_[card->second];
+	player_drawn_.erase(card);
+	n_draws_--;
+	return ret;
+}
+
+Tracker::result_t Tracker::infect(const std::string &name)
+{
+	auto ret = resolve(name);
+	return ret.status == OK? infect(*ret.card) : ret;
+}
+
+Tracker::result_t Tracker::infect(const card_t &city)
+{
+	result_t ret = {OK, &city};
+	
+	if(infection_deck_.empty())
+		return {EMPTY_DECK, ret.card};
+	
+	auto &top = infection_deck_.back();
+	auto card = top.find(ret.card->first);
+	if(card == top.end())
+		return {NOT_IN_PILE, ret.card};
+	
+	add_cubes(card->first, 1);
+	toggle(card->first, stratum_place + infection_deck_.size() - 1);
+	toggle(card->first, INFECTION_DISCARD);
+	infection_discard_.insert(*card);
+	n_infects_++;
+	top.erase(card);
+	settle_infects();
+	return ret;
+}
+
+Tracker::result_t Tracker::uninfect(const std::string &name)
+{
+	auto ret = resolve(name);
+	if(ret.status != OK)
+		return ret;
+	
+	auto card = infection_discard_.find(ret.card->first);
+	if(card == infection_discard_.end())
+		return {NOT_IN_PILE, ret.card};
+	
+	add_cubes(card->first, -1);
+	if(infection_deck_.empty())
+	{
+		infection_deck_.emplace_back();
+		unknown_infects_.push_back(0);
+	}
+	toggle(card->first, INFECTION_DISCARD);
+	toggle(card->first, stratum_place + infection_deck_.size() - 1);
+	infection_deck_.back().insert(*card);
+	infection_discard_.erase(card);
+	n_infects_--;
+	return ret;
+}
+
+Tracker::result_t Tracker::epidemic(const std::string &name)
+{
+	auto ret = resolve(name);
+	return ret.status == OK? epidemic(*ret.card) : ret;
+}
+
+Tracker::result_t Tracker::epidemic(const card_t &city)
+{
+	result_t ret = {OK, &city};
+	
+	if(infection_deck_.empty() ||
+	   infection_deck_.front().count(ret.card->first) == 0)
+		return {NOT_IN_PILE, ret.card};
+	
+	current_epidemics_++;
+	n_draws_++;
+	
+	auto &bottom = infection_deck_.front();
+	auto card = bottom.find(ret.card->first);
+	cubes_[card->first] += 3;
+	infection_discard_.insert(*card);
+	bottom.erase(card);
+	if(bottom.size() == 0)
+	{
+		infection_deck_.erase(infection_deck_.begin());
+		unknown_infects_.erase(unknown_infects_.begin());
+	}
+	
+	// cards infected unseen are in the discard, so they get shuffled onto the
+	// top along with it. Which ones is unknown, so their whole strata go too,
+	// keeping the cards right at the cost of some of their order.
+	std::vector<std::tuple<size_t, deck_t, int>> folded;
+	for(size_t i = 0, position = 0; i < infection_deck_.size(); position++)
+	{
+		if(unknown_infects_[i] == 0)
+		{
+			i++;
+			continue;
+		}
+		
+		infection_discard_.insert(infection_deck_[i].begin(),
+								  infection_deck_[i].end());
+		folded.emplace_back(position, std::move(infection_deck_[i]),
+							unknown_infects_[i]);
+		infection_deck_.erase(infection_deck_.begin() + i);
+		unknown_infects_.erase(unknown_infects_.begin() + i);
+	}
+	folds_.push_back(std::move(folded));
+	
+	infection_deck_.push_back(std::move(infection_discard_));
+	unknown_infects_.push_back(0);
+	infection_discard_.clear();
+	
+	// every stratum can move, so it's simplest to start the hash over
+	hash_ = pile_hash();
+	return ret;
+}
+
+Tracker::result_t Tracker::unepidemic(const std::string &name)
+{
+	auto ret = resolve(name);
+	if(ret.status != OK)
+		return ret;
+	
+	if(current_epidemics_ == 0 || infection_deck_.empty() ||
+	   infection_deck_.back().count(ret.card->first) == 0)
+		return {NOT_IN_PILE, ret.card};
+	
+	auto folded = folds_.empty()? decltype(folds_)::value_type() : folds_.back();
+	for(const auto &fold : folded)
+		if(std::get<deck_t>(fold).count(ret.card->first))
+			return {NOT_IN_PILE, ret.card};
+	
+	current_epidemics_--;
+	n_draws_--;
+	if(!folds_.empty())
+		folds_.pop_back();
+	
+	auto top = std::move(infection_deck_.back());
+	infection_deck_.pop_back();
+	unknown_infects_.pop_back();
+	
+	auto card = top.find(ret.card->first);
+	auto bottom_card = *card;
+	cubes_[card->first] = std::max(cubes_[card->first] - 3, 0);
+	top.erase(card);
+	
+	// put back the strata the epidemic shuffled in, less anything infected
+	// since, unless all that's left of them was gone unseen anyway
+	for(auto &[position, stratum, unknown] : folded)
+	{
+		deck_t restored;
+		for(const auto &card : stratum)
+			if(top.erase(card.first))
+				restored.insert(card);
+		
+		if(int(restored.size()) <= unknown)
+		{
+			top.insert(restored.begin(), restored.end());
+			continue;
+		}
+		
+		position = std::min(position, infection_deck_.size());
+		infection_deck_.insert(infection_deck_.begin() + position,
+							   std::move(restored));
+		unknown_infects_.insert(unknown_infects_.begin() + position, unknown);
+	}
+	
+	if(infection_deck_.empty())
+	{
+		infection_deck_.emplace_back();
+		unknown_infects_.push_back(0);
+	}
+	infection_deck_.front().insert(bottom_card);
+	infection_discard_.insert(top.begin(), top.end());
+	
+	hash_ = pile_hash();
+	return ret;
+}
+
+Tracker::result_t Tracker::resilient_population(const std::string &name)
+{
+	auto ret = resolve(name);
+	if(ret.status != OK)
+		return ret;
+	
+	// it can only be removed from the discard if it was infected unseen
+	if(infection_discard_.count(ret.card->first) == 0 &&
+	   reveal(INFECTION_DECK, name).status != OK)
+		return {NOT_IN_PILE, ret.card};
+	
+	auto card = infection_discard_.find(ret.card->first);
+	toggle(card->first, INFECTION_DISCARD);
+	toggle(card->first, INFECTION_REMOVED);
+	infection_removed_.insert(*card);
+	infection_discard_.erase(card);
+	return ret;
+}
+
+Tracker::result_t Tracker::give(int player, const std::string &name)
+{
+	auto ret = resolve(name);
+	return ret.status == OK? give(player, *ret.card) : ret;
+}
+
+Tracker::result_t Tracker::give(int player, const card_t &city)
+{
+	result_t ret = {OK, &city};
+	
+	// any more and the hand's keys would be another place's
+	if(player < 0 || player > max_player)
+		return {BAD_ARGUMENT, ret.card};
+	
+	// someone holding it shows it was drawn unseen
+	if(player_drawn_.count(ret.card->first) == 0 &&
+	   reveal(PLAYER_DECK, city.first).status != OK)
+		return {NOT_IN_PILE, ret.card};
+	
+	discard(city);
+	toggle(ret.card->first, hand_place + player);
+	hands_[player].insert(*ret.card);
+	return ret;
+}
+
+Tracker::result_t Tracker::discard(const std::string &name)
+{
+	auto ret = resolve(name);
+	return ret.status == OK? discard(*ret.card) : ret;
+}
+
+Tracker::result_t Tracker::discard(const card_t &city)
+{
+	result_t ret = {OK, &city};
+	
+	for(auto &hand : hands_)
+	{
+		if(hand.second.erase(ret.card->first))
+		{
+			toggle(ret.card->first, hand_place + hand.first);
+			return ret;
+		}
+	}
+	
+	return {NOT_IN_PILE, ret.card};
+}
+
+Tracker::result_t Tracker::build_station(const std::string &name)
+{
+	auto ret = resolve(name);
+	if(ret.status != OK)
+		return ret;
+	
+	if(ret.card->second == EVENT)
+		return {INVALID, ret.card};
+	if(stations_.count(ret.card->first))
+		return {NOT_IN_PILE, ret.card};
+	
+	toggle(ret.card->first, station_place);
+	stations_.insert(*ret.card);
+	if(!routes_.empty())
+		routes_.add_station(index(*ret.card));
+	return ret;
+}
+
+Tracker::result_t Tracker::remove_station(const std::string &name)
+{
+	auto ret = resolve(name);
+	if(ret.status != OK)
+		return ret;
+	
+	if(stations_.erase(ret.card->first) == 0)
+		return {NOT_IN_PILE, ret.card};
+	
+	toggle(ret.card->first, station_place);
+	if(!routes_.empty())
+		routes_.remove_station(index(*ret.card));
+	return ret;
+}
+
+bool Tracker::set_connections(const connections_t &connections)
+{
+	// the table would drop the cities past its limit, leaving their indices
+	// off the end of it
+	if(cities_.size() > size_t(RouteMap::max_cities))
+	{
+		routes_ = RouteMap();
+		return false;
+	}
+	
+	std::vector<std::string> names;
+	for(const auto &card : cities_)
+		names.push_back(card.first);
+	
+	routes_ = RouteMap(names, connections);
+	for(const auto &card : stations_)
+		routes_.add_station(index(card));
+	return true;
+}
+
+int Tracker::index(const card_t &card) const
+{
+	return std::distance(cities_.begin(), cities_.find(card.first));
+}
+
+Tracker::result_t Tracker::draw_unknown()
+{
+	if(unknown_draws_ >= int(player_deck_.size()))
+		return {EMPTY_DECK, nullptr};
+	
+	unknown_draws_++;
+	n_draws_++;
+	settle_draws();
+	return {OK, nullptr};
+}
+
+Tracker::result_t Tracker::undraw_unknown()
+{
+	if(unknown_draws_ == 0)
+		return {NOT_IN_PILE, nullptr};
+	
+	unknown_draws_--;
+	n_draws_--;
+	return {OK, nullptr};
+}
+
+Tracker::result_t Tracker::infect_unknown()
+{
+	if(infection_deck_.empty())
+		return {EMPTY_DECK, nullptr};
+	
+	unknown_infects_.back()++;
+	n_infects_++;
+	settle_infects();
+	return {OK, nullptr};
+}
+
+Tracker::result_t Tracker::uninfect_unknown()
+{
+	if(infection_deck_.empty() || unknown_infects_.back() == 0)
+		return {NOT_IN_PILE, nullptr};
+	
+	unknown_infects_.back()--;
+	n_infects_--;
+	return {OK, nullptr};
+}
+
+Tracker::result_t Tracker::reveal(pile_t from, const std::string &name)
+{
+	auto ret = resolve(name);
+	if(ret.status != OK)
+		return ret;
+	
+	if(from == PLAYER_DECK && unknown_draws_ > 0)
+	{
+		auto card = player_deck_.find(ret.card->first);
+		if(card == player_deck_.end())
+			return {NOT_IN_PILE, ret.card};
+		
+		toggle(card->first, PLAYER_DECK);
+		toggle(card->first, PLAYER_DRAWN);
+		player_drawn_.insert(*card);
+		--deck_counts_[card->second];
+		player_deck_.erase(card);
+		unknown_draws_--;
+		return ret;
+	}
+	
+	if(from == INFECTION_DECK)
+	{
+		for(size_t i = infection_deck_.size(); i-- > 0;)
+		{
+			auto card = infection_deck_[i].find(ret.card->first);
+			if(card == infection_deck_[i].end())
+				continue;
+			if(unknown_infects_[i] == 0)
+				break;
+			
+			add_cubes(card->first, 1);
+			toggle(card->first, stratum_place + i);
+			toggle(card->first, INFECTION_DISCARD);
+			infection_discard_.insert(*card);
+			infection_deck_[i].erase(card);
+			unknown_infects_[i]--;
+			return ret;
+		}
+	}
+	
+	return {NOT_IN_PILE, ret.card};
+}
+
+pile_odds_t Tracker::pile_odds(const card_t &card) const
+{
+	pile_odds_t odds = {};
+	if(player_drawn_.count(card.first))
+	{
+		odds[PLAYER_DRAWN] = 1.0;
+	}
+	else if(player_deck_.count(card.first))
+	{
+		odds[PLAYER_DRAWN] = double(unknown_draws_) / player_deck_.size();
+		odds[PLAYER_DECK] = 1.0 - odds[PLAYER_DRAWN];
+	}
+	
+	if(infection_discard_.count(card.first))
+		odds[INFECTION_DISCARD] = 1.0;
+	else if(infection_removed_.count(card.first))
+		odds[INFECTION_REMOVED] = 1.0;
+	else for(size_t i = 0; i < infection_deck_.size(); i++)
+	{
+		if(infection_deck_[i].count(card.first) == 0)
+			continue;
+		
+		odds[INFECTION_DISCARD] =
+			double(unknown_infects_[i]) / infection_deck_[i].size();
+		odds[INFECTION_DECK] = 1.0 - odds[INFECTION_DISCARD];
+		break;
+	}
+	
+	return odds;
+}
+
+void Tracker::settle_draws()
+{
+	if(unknown_draws_ == 0 || unknown_draws_ < int(player_deck_.size()))
+		return;
+	
+	for(const auto &card : player_deck_)
+	{
+		toggle(card.first, PLAYER_DECK);
+		toggle(card.first, PLAYER_DRAWN);
+	}
+	player_drawn_.insert(player_deck_.begin(), player_deck_.end());
+	player_deck_.clear();
+	deck_counts_.fill(0);
+	unknown_draws_ = 0;
+}
+
+void Tracker::settle_infects()
+{
+	while(!infection_deck_.empty() &&
+		  int(infection_deck_.back().size()) <= unknown_infects_.back())
+	{
+		for(const auto &card : infection_deck_.back())
+		{
+			add_cubes(card.first, 1);
+			toggle(card.first, stratum_place + infection_deck_.size() - 1);
+			toggle(card.first, INFECTION_DISCARD);
+		}
+		infection_discard_.insert(infection_deck_.back().begin(),
+								  infection_deck_.back().end());
+		infection_deck_.pop_back();
+		unknown_infects_.pop_back();
+	}
+}
+
+Tracker::result_t Tracker::forecast(const std::vector<std::string> &names)
+{
+	auto strata = infection_deck_;
+	auto unknowns = unknown_infects_;
+	std::vector<card_t> forecast;
+	deck_t settled;
+	for(const auto &name : names)
+	{
+		auto ret = resolve(name);
+		if(ret.status == OK && strata.empty())
+			ret.status = EMPTY_DECK;
+		else if(ret.status == OK && strata.back().count(ret.card->first) == 0)
+			ret.status = NOT_IN_PILE;
+		if(ret.status != OK)
+			return ret;
+		
+		auto card = strata.back().find(ret.card->first);
+		forecast.push_back(*card);
+		strata.back().erase(card);
+		if(int(strata.back().size()) <= unknowns.back())
+		{
+			settled.insert(strata.back().begin(), strata.back().end());
+			strata.pop_back();
+			unknowns.pop_back();
+		}
+	}
+	
+	for(auto ri = forecast.rbegin(); ri != forecast.rend(); ++ri)
+	{
+		strata.push_back({*ri});
+		unknowns.push_back(0);
+	}
+	
+	for(const auto &card : settled)
+		cubes_[card.first]++;
+	infection_discard_.insert(settled.begin(), settled.end());
+	infection_deck_ = std::move(strata);
+	unknown_infects_ = std::move(unknowns);
+	hash_ = pile_hash();
+	return {OK, nullptr};
+}
+
+Tracker::turn_result_t Tracker::turn(const turn_t &turn)
+{
+	// checked first so nothing needs undoing, then played in place with the
+	// cards the check resolved
+	std::vector<const card_t *> cards;
+	if(auto ret = check_turn(turn, cards); ret.result.status != OK)
+		return ret;
+	
+	auto card = cards.begin();
+	for(const auto &name : turn.draws)
+	{
+		auto ret = *card? draw(**card) : draw_unknown();
+		if(ret.status == OK && turn.player >= 0 && *card)
+			ret = give(turn.player, **card);
+		if(ret.status != OK)
+			return {ret, &name};
+		card++;
+	}
+	
+	for(const auto &name : turn.epidemics)
+		if(auto ret = epidemic(**card++); ret.status != OK)
+			return {ret, &name};
+	
+	for(const auto &name : turn.infections)
+		if(auto ret = *card? infect(**card) : infect_unknown(); ret.status != OK)
+			return {ret, &name};
+		else
+			card++;
+	
+	expected_infects_ += infection_rate(current_epidemics_);
+	return {{OK, nullptr}, nullptr};
+}
+
+Tracker::turn_result_t Tracker::check_turn(const turn_t &turn,
+	std::vector<const card_t *> &cards) const
+{
+	// a player past max_player would hash as another place, while a negative
+	// one keeps the cards out of every hand
+	if(turn.player > max_player)
+		return {{BAD_ARGUMENT, nullptr}, nullptr};
+	
+	// a turn takes two player cards, epidemics included, and only fewer when
+	// they're the last of the deck, checked before anything is looked up
+	auto player_card = [&turn](size_t i) -> const std::string &
+	{
+		return i < turn.draws.size()? turn.draws[i] :
+			turn.epidemics[i - turn.draws.size()];
+	};
+	size_t n_cards = turn.draws.size() + turn.epidemics.size();
+	size_t left = std::max(0, total_cards_ - n_draws_);
+	if(n_cards > cards_per_turn)
+		return {{BAD_ARGUMENT, nullptr}, &player_card(cards_per_turn)};
+	if(n_cards > left)
+		return {{EMPTY_DECK, nullptr}, &player_card(left)};
+	if(n_cards < std::min(size_t(cards_per_turn), left))
+		return {{BAD_ARGUMENT, nullptr}, nullptr};
+	
+	// the player deck, as the draws so far would leave it
+	int deck_size = player_deck_.size();
+	int unknown_draws = unknown_draws_;
+	std::vector<const card_t *> drawn;
+	cards.clear();
+	for(const auto &name : turn.draws)
+	{
+		if(name.empty())
+		{
+			if(unknown_draws >= deck_size)
+				return {{EMPTY_DECK, nullptr}, &name};
+			unknown_draws++;
+			cards.push_back(nullptr);
+		}
+		else
+		{
+			auto ret = resolve(name);
+			if(ret.status != OK)
+				return {ret, &name};
+			if((unknown_draws > 0 && unknown_draws >= deck_size) ||
+			   player_deck_.count(ret.card->first) == 0 ||
+			   std::find(drawn.begin(), drawn.end(), ret.card) != drawn.end())
+				return {{NOT_IN_PILE, ret.card}, &name};
+			drawn.push_back(ret.card);
+			cards.push_back(ret.card);
+			deck_size--;
+		}
+		
+		// unseen draws covering the rest of the deck draw all of it
+		if(unknown_draws > 0 && unknown_draws >= deck_size)
+			deck_size = 0;
+	}
+	
+	// the infection deck's strata, top last, and the discard, as the turn
+	// would leave them, made of the piles they'd hold less the cards taken
+	struct stratum_t
+	{
+		std::vector<const deck_t *> piles;
+		std::vector<const card_t *> cards;
+		std::vector<const card_t *> taken;
+		int unknown = 0;
+		
+		// taken only counts against the piles, which never hold cards twice
+		bool has(const card_t *card) const
+		{
+			if(std::find(cards.begin(), cards.end(), card) != cards.end())
+				return true;
+			return std::find(taken.begin(), taken.end(), card) == taken.end() &&
+				std::any_of(piles.begin(), piles.end(), [card](const deck_t *pile)
+				{
+					return pile->count(card->first) != 0;
+				});
+		}
+		
+		void take(const card_t *card)
+		{
+			auto held = std::find(cards.begin(), cards.end(), card);
+			if(held != cards.end())
+				cards.erase(held);
+			else
+				taken.push_back(card);
+		}
+		
+		int size() const
+		{
+			int ret = cards.size() - taken.size();
+			for(const auto *pile : piles)
+				ret += pile->size();
+			return ret;
+		}
+		
+		void merge(stratum_t &&other)
+		{
+			piles.insert(piles.end(), other.piles.begin(), other.piles.end());
+			cards.insert(cards.end(), other.cards.begin(), other.cards.end());
+			taken.insert(taken.end(), other.taken.begin(), other.taken.end());
+		}
+	};
+	
+	// strata are only looked at from the top down until an epidemic, so
+	// those below the ones looked at so far are left as they are
+	std::vector<stratum_t> strata;
+	size_t below = infection_deck_.size();
+	auto look_below = [&]()
+	{
+		below--;
+		strata.insert(strata.begin(), {{&infection_deck_[below]}, {}, {},
+									   unknown_infects_[below]});
+	};
+	if(below > 0)
+		look_below();
+	stratum_t discard = {{&infection_discard_}, {}, {}, 0};
+	
+	// as epidemic() does
+	for(const auto &name : turn.epidemics)
+	{
+		auto ret = resolve(name);
+		if(ret.status != OK)
+			return {ret, &name};
+		while(below > 0)
+			look_below();
+		if(strata.empty() || !strata.front().has(ret.card))
+			return {{NOT_IN_PILE, ret.card}, &name};
+		
+		cards.push_back(ret.card);
+		strata.front().take(ret.card);
+		if(strata.front().size() == 0)
+			strata.erase(strata.begin());
+		
+		stratum_t top = std::move(discard);
+		discard = {};
+		top.cards.push_back(ret.card);
+		for(size_t i = 0; i < strata.size();)
+		{
+			if(strata[i].unknown == 0)
+			{
+				i++;
+				continue;
+			}
+			
+			top.merge(std::move(strata[i]));
+			strata.erase(strata.begin() + i);
+		}
+		top.unknown = 0;
+		strata.push_back(std::move(top));
+	}
+	
+	// as infect() and settle_infects() do
+	int rate = infection_rate(current_epidemics_ + turn.epidemics.size());
+	for(size_t i = 0; i < turn.infections.size(); i++)
+	{
+		const auto &name = turn.infections[i];
+		if(int(i) >= rate)
+			return {{OVER_RATE, nullptr}, &name};
+		
+		if(name.empty())
+		{
+			if(strata.empty())
+				return {{EMPTY_DECK, nullptr}, &name};
+			strata.back().unknown++;
+			cards.push_back(nullptr);
+		}
+		else
+		{
+			auto ret = resolve(name);
+			if(ret.status != OK)
+				return {ret, &name};
+			if(strata.empty())
+				return {{EMPTY_DECK, ret.card}, &name};
+			if(!strata.back().has(ret.card))
+				return {{NOT_IN_PILE, ret.card}, &name};
+			strata.back().take(ret.card);
+			cards.push_back(ret.card);
+		}
+		
+		while(!strata.empty() && strata.back().size() <= strata.back().unknown)
+		{
+			strata.pop_back();
+			if(strata.empty() && below > 0)
+				look_below();
+		}
+	}
+	
+	return {{OK, nullptr}, nullptr};
+}
+
+Tracker::result_t Tracker::forecast_best(const std::vector<std::string> &names,
+	size_t keep, std::vector<ranked_forecast_t> &ranked) const
+{
+	// check the cards really are on top without touching the deck
+	auto strata = infection_deck_;
+	auto unknowns = unknown_infects_;
+	std::vector<const card_t *> forecast;
+	for(const auto &name : names)
+	{
+		auto ret = resolve(name);
+		if(ret.status == OK && strata.empty())
+			ret.status = EMPTY_DECK;
+		else if(ret.status == OK && strata.back().count(ret.card->first) == 0)
+			ret.status = NOT_IN_PILE;
+		if(ret.status != OK)
+			return ret;
+		
+		forecast.push_back(ret.card);
+		strata.back().erase(ret.card->first);
+		if(int(strata.back().size()) <= unknowns.back())
+		{
+			strata.pop_back();
+			unknowns.pop_back();
+		}
+	}
+	
+	// orders are cached as positions in the names given
+	uint64_t key = mix64(state_hash() ^ keep);
+	for(const auto *card : forecast)
+		key = mix64(key ^ card_key(card->first, 0));
+	
+	auto orders = cache_->find<std::vector<ranked_order_t>>(
+		ResultCache::FORECAST_BEST, key);
+	if(!orders)
+	{
+		auto model = risk_model();
+		std::vector<std::vector<double>> cost(forecast.size());
+		for(size_t c = 0; c < forecast.size(); c++)
+			for(size_t position = 0; position < forecast.size(); position++)
+				cost[c].push_back(model.forecast_risk(position,
+					std::min(cubes(forecast[c]->first), 3)));
+		
+		orders = cache_->insert(ResultCache::FORECAST_BEST, key,
+								rank_orderings(cost, keep));
+	}
+	
+	ranked.clear();
+	for(const auto &order : *orders)
+	{
+		ranked.push_back({order.risk, {}});
+		for(auto c : order.order)
+			ranked.back().cards.push_back(forecast[c]);
+	}
+	
+	return {OK, nullptr};
+}
+
+std::vector<std::pair<double, const card_t *>> Tracker::resilient_best() const
+{
+	// cached by name, as the cards themselves belong to this copy
+	using named_t = std::vector<std::pair<double, std::string>>;
+	uint64_t key = state_hash();
+	if(auto named = cache_->find<named_t>(ResultCache::RESILIENT_BEST, key))
+	{
+		std::vector<std::pair<double, const card_t *>> ranked;
+		for(const auto &[risk, name] : *named)
+			ranked.emplace_back(risk, &*cities_.find(name));
+		return ranked;
+	}
+	
+	auto model = risk_model();
+	std::vector<std::pair<double, const card_t *>> ranked;
+	for(const auto &card : infection_discard_)
+		ranked.emplace_back(model.discard_risk(std::min(cubes(card.first), 3)),
+							&*cities_.find(card.first));
+	
+	// cards that might have been infected unseen, by the chance they were
+	for(size_t i = 0; i < infection_deck_.size(); i++)
+	{
+		double odds = double(unknown_infects_[i]) / infection_deck_[i].size();
+		if(odds > 0.0)
+			for(const auto &card : infection_deck_[i])
+				ranked.emplace_back(odds *
+					model.discard_risk(std::min(cubes(card.first), 3)),
+					&*cities_.find(card.first));
+	}
+	
+	std::stable_sort(ranked.begin(), ranked.end(),
+		[](const auto &a, const auto &b) { return a.first > b.first; });
+	
+	named_t named;
+	for(const auto &[risk, card] : ranked)
+		named.emplace_back(risk, card->first);
+	cache_->insert(ResultCache::RESILIENT_BEST, key, std::move(named));
+	return ranked;
+}
+
+std::pair<int, int> Tracker::epidemic_window() const
+{
+	return epidemic_window(current_epidemics_);
+}
+
+std::pair<int, int> Tracker::epidemic_window(int epidemic) const
+{
+	int safe_phase = 0;
+	if(epidemic < big_stacks_)
+		safe_phase = epidemic * (cards_per_epidemic_ + 1);
+	else
+		safe_phase = big_stacks_ * (cards_per_epidemic_ + 1) +
+			(epidemic - big_stacks_) * cards_per_epidemic_;
+	
+	int next_phase = safe_phase + 
+				cards_per_epidemic_ + (epidemic < big_stacks_);
+	
+	return std::make_pair(safe_phase, next_phase);
+}
+
+cure_odds_t Tracker::cure_odds(int turns) const
+{
+	turns = std::clamp(turns, 0, std::max(0, (total_cards_ - n_draws_ + 1) / 2));
+	uint64_t key = mix64(state_hash() ^ turns);
+	if(auto cached = cache_->find<cure_odds_t>(ResultCache::CURE_ODDS, key))
+		return *cached;
+	
+	auto &cache = *cure_cache_;
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	const int deck_size = player_deck_.size();
+	const int draws = 2 * turns;
+	
+	// the epidemics drawn only depend on how far through the deck we are
+	if(cache.turns != turns || cache.n_draws != n_draws_ ||
+	   cache.current_epidemics != current_epidemics_)
+	{
+		cache.turns = turns;
+		cache.n_draws = n_draws_;
+		cache.current_epidemics = current_epidemics_;
+		cache.inputs.fill({-1, -1, -1, -1});
+		
+		// each epidemic left is equally likely anywhere in its window
+		cache.epidemics.assign(1, 1.0);
+		for(int e = current_epidemics_; e < epidemics_; e++)
+		{
+			auto [safe_phase, next_phase] = epidemic_window(e);
+			int first = std::max(safe_phase, n_draws_);
+			int last = std::max(next_phase, first + 1);
+			double odds = std::clamp(
+				double(std::min(last, n_draws_ + draws) - first) / (last - first),
+				0.0, 1.0);
+			
+			cache.epidemics.push_back(0.0);
+			for(size_t n = cache.epidemics.size() - 1; n > 0; n--)
+				cache.epidemics[n] = cache.epidemics[n] * (1 - odds) +
+					cache.epidemics[n - 1] * odds;
+			cache.epidemics[0] *= 1 - odds;
+		}
+	}
+	
+	// cards drawn unseen are a random few of the deck, of any color
+	const int left = deck_size - unknown_draws_;
+	
+	for(int color = 0; color < EVENT; color++)
+	{
+		int held = 0;
+		for(const auto &hand : hands_)
+			held = std::max<int>(held, std::count_if(hand.second.begin(),
+				hand.second.end(), [color](const auto &card)
+				{
+					return card.second == color;
+				}));
+		
+		auto inputs = std::make_tuple(deck_size, unknown_draws_,
+									  deck_counts_[color], held);
+		if(cache.inputs[color] == inputs)
+			continue;
+		
+		cache.inputs[color] = inputs;
+		double odds = 0.0;
+		for(int gone = 0; gone <= unknown_draws_; gone++)
+		{
+			double gone_odds = draw_pmf(deck_size, deck_counts_[color],
+										unknown_draws_, gone);
+			if(gone_odds == 0.0)
+				continue;
+			
+			for(size_t e = 0; e < cache.epidemics.size(); e++)
+			{
+				int drawn = std::clamp(draws - int(e), 0, left);
+				odds += gone_odds * cache.epidemics[e] *
+					draw_odds(left, deck_counts_[color] - gone, drawn,
+							  cards_to_cure - held);
+			}
+		}
+		cache.odds[color] = odds;
+	}
+	
+	cache_->insert(ResultCache::CURE_ODDS, key, cache.odds);
+	return cache.odds;
+}
+
+uint64_t Tracker::state_hash() const
+{
+	uint64_t hash = hash_;
+	auto mix = [&hash](uint64_t n)
+	{
+		hash = mix64(hash ^ n);
+	};
+	
+	mix(n_draws_);
+	mix(current_epidemics_);
+	mix(epidemics_);
+	mix(initial_draws_);
+	mix(unknown_draws_);
+	for(int unknown : unknown_infects_)
+		mix(unknown);
+	
+	return hash;
+}
+
+uint64_t Tracker::card_key(const std::string &card, int place)
+{
+	return mix64(std::hash<std::string>{}(card) +
+				 0x9e3779b97f4a7c15 * (place + 1ull));
+}
+
+void Tracker::add_cubes(const std::string &city, int n)
+{
+	int &cubes = cubes_[city];
+	if(cubes)
+		toggle(city, cube_place + cubes);
+	cubes = std::max(cubes + n, 0);
+	if(cubes)
+		toggle(city, cube_place + cubes);
+}
+
+uint64_t Tracker::pile_hash() const
+{
+	uint64_t hash = 0;
+	auto add = [&hash](const deck_t &pile, int place)
+	{
+		for(const auto &card : pile)
+			hash ^= card_key(card.first, place);
+	};
+	
+	add(player_deck_, PLAYER_DECK);
+	add(player_drawn_, PLAYER_DRAWN);
+	add(infection_discard_, INFECTION_DISCARD);
+	add(infection_removed_, INFECTION_REMOVED);
+	for(size_t i = 0; i < infection_deck_.size(); i++)
+		add(infection_deck_[i], stratum_place + i);
+	for(const auto &[player, hand] : hands_)
+		add(hand, hand_place + player);
+	add(stations_, station_place);
+	for(const auto &[city, cubes] : cubes_)
+		if(cubes)
+			hash ^= card_key(city, cube_place + cubes);
+	
+	return hash;
+}
+
+risk_model_t Tracker::risk_model() const
+{
+	risk_model_t model;
+	model.rate = infection_rate(current_epidemics_);
+	model.epidemic_rate = infection_rate(current_epidemics_ + 1);
+	// counting the cards infected unseen
+	model.discard_size = infection_discard_.size();
+	for(int unknown : unknown_infects_)
+		model.discard_size += unknown;
+	model.epidemic_odds.assign(risk_horizon, 0.0);
+	
+	// with every epidemic drawn there's no window left, only the rate
+	if(current_epidemics_ >= epidemics_)
+	{
+		model.epidemic_rate = model.rate;
+		return model;
+	}
+	
+	// the next epidemic is equally likely to be any draw left in its window
+	auto [safe_phase, next_phase] = epidemic_window();
+	int first = std::max(safe_phase, n_draws_) + 1;
+	for(int draw = first; draw <= next_phase; draw++)
+	{
+		int turn = (draw - n_draws_ - 1) / 2 + 1;
+		if(turn < risk_horizon)
+			model.epidemic_odds[turn] += 1.0 / (next_phase - first + 1);
+	}
+	
+	return model;
+}
+
+int Tracker::cubes(const std::string &city) const
+{
+	auto n = cubes_.find(city);
+	return n == cubes_.end()? 0 : n->second;
+}
+
+std::string Tracker::check(bool routes) const
+{
+	auto by_name = [](const LazyString *a, const LazyString *b)
+	{
+		return *a < *b;
+	};
+	
+	if(hash_ != pile_hash())
+		return "state hash is stale";
+	if(routes && routes_.stale())
+		return "route table is stale";
+	auto card = cities_.begin();
+	for(int city = 0; routes && city < routes_.size(); city++, ++card)
+		if(routes_.station(city) != bool(stations_.count(card->first)))
+			return "route stations out of step";
+	if(unknown_infects_.size() != infection_deck_.size())
+		return "unknown infection counts out of step with the strata";
+	for(size_t i = 0; i < infection_deck_.size(); i++)
+		if(unknown_infects_[i] < 0 ||
+		   unknown_infects_[i] >= int(infection_deck_[i].size()))
+			return "bad unknown infection count";
+	if(unknown_draws_ < 0 || (unknown_draws_ > 0 &&
+							  unknown_draws_ >= int(player_deck_.size())))
+		return "bad unknown draw count";
+	if(int(folds_.size()) != current_epidemics_)
+		return "epidemic folds out of step with the epidemics";
+	
+	// every infection card is in exactly one pile
+	std::vector<const LazyString *> infections;
+	for(const auto &stratum : infection_deck_)
+	{
+		if(stratum.empty())
+			return "empty infection deck stratum";
+		for(const auto &card : stratum)
+			infections.push_back(&card.first);
+	}
+	for(const auto *pile : {&infection_discard_, &infection_removed_})
+		for(const auto &card : *pile)
+			infections.push_back(&card.first);
+	std::sort(infections.begin(), infections.end(), by_name);
+	
+	auto infection = infections.begin();
+	for(const auto &card : cities_)
+	{
+		if(card.second == EVENT) continue;
+		if(infection == infections.end() ||
+		   static_cast<const std::string &>(**infection++) != card.first)
+			return card.first + " is not in exactly one infection pile";
+	}
+	if(infection != infections.end())
+		return "too many infection cards";
+	
+	// and every player card is in exactly one of the player piles
+	std::vector<const LazyString *> players;
+	for(const auto *pile : {&player_deck_, &player_drawn_})
+		for(const auto &card : *pile)
+			players.push_back(&card.first);
+	std::inplace_merge(players.begin(), players.begin() + player_deck_.size(),
+					   players.end(), by_name);
+	
+	auto player = players.begin();
+	for(const auto &card : cities_)
+		if(player == players.end() ||
+		   static_cast<const std::string &>(**player++) != card.first)
+			return card.first + " is not in exactly one player pile";
+	
+	if(player_deck_.size() + player_drawn_.size() != cities_.size())
+		return "player piles don't add up to the deck";
+	
+	std::array<int, N_COLORS> counts = {};
+	for(const auto &card : player_deck_)
+		++counts[card.second];
+	if(counts != deck_counts_)
+		return "player deck color counts are stale";
+	
+	size_t held = 0;
+	for(const auto &[player, hand] : hands_)
+	{
+		held += hand.size();
+		for(const auto &card : hand)
+			if(player_drawn_.count(card.first) == 0)
+				return card.first + " is in player " + std::to_string(player) +
+					"'s hand but not drawn";
+	}
+	
+	std::set<std::string> holders;
+	for(const auto &hand : hands_)
+		for(const auto &card : hand.second)
+			holders.insert(card.first);
+	if(holders.size() != held)
+		return "a card is in more than one hand";
+	if(n_draws_ != int(player_drawn_.size()) + unknown_draws_ +
+	   current_epidemics_ - initial_draws_)
+		return "draw count doesn't match the cards drawn";
+	if(current_epidemics_ < 0)
+		return "negative epidemic count";
+	for(const auto &[city, n] : cubes_)
+		if(n < 0)
+			return city + " has negative cubes";
+	
+	return "";
+}
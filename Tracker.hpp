@@ -0,0 +1,301 @@
+#ifndef PANDEMIC_TRACKER_HEADER_FILE
+#define PANDEMIC_TRACKER_HEADER_FILE
+
+#include <map>
+#include <string>
+#include <vector>
+#include <array>
+#include <tuple>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include "Routes.hpp"
+
+enum color_t {YELLOW = 0, RED, BLUE, BLACK, EVENT, N_COLORS};
+color_t to_color(const std::string &str);
+std::string color_to_string(color_t color);
+
+/* Case insensitive string where a prefix compares equal to the whole, so
+ * decks can be searched with abbreviated card names.
+ */
+class LazyString: public std::string
+{
+public:
+	using std::string::string;
+	LazyString(const std::string &s): std::string(s) {}
+};
+
+bool operator== (const LazyString &lhs, const LazyString &rhs);
+bool operator< (const LazyString &lhs, const LazyString &rhs);
+
+using deck_t = std::map<LazyString, color_t>;
+using card_t = deck_t::value_type;
+
+deck_t load_cities(const std::string &filename);
+
+// infection cards drawn each turn after so many epidemics
+int infection_rate(int epidemics);
+
+struct risk_model_t;
+class ResultCache;
+
+struct ranked_forecast_t
+{
+	double risk;
+	std::vector<const card_t *> cards;
+};
+
+// chance of curing each disease color, indexed by color_t
+using cure_odds_t = std::array<double, EVENT>;
+
+enum pile_t {PLAYER_DECK = 0, PLAYER_DRAWN, INFECTION_DISCARD,
+			 INFECTION_REMOVED, INFECTION_DECK, N_PILES};
+// chance of a card being in each pile. A city's player and infection cards
+// are both counted, so each deck's piles sum to one.
+using pile_odds_t = std::array<double, N_PILES>;
+std::string pile_to_string(pile_t pile);
+
+/* Deck model of a game of pandemic.
+ *
+ * Commands take card names as typed, and report the card they resolved to
+ * alongside a status. A command that fails leaves the game untouched.
+ * Cards reported by the tracker point into cities(), which lives as long as
+ * the tracker does.
+ *
+ * Drawn cards can be placed in numbered players' hands. Cards drawn but in
+ * no hand have been discarded, or just not assigned yet.
+ *
+ * Cards can also be drawn or infected unseen. Those stay listed in the pile
+ * they came from, which keeps a count of how many of its cards are really
+ * gone, every listed card being equally likely to be one of them. Once a
+ * pile's listed cards are all accounted for they move on, and naming the
+ * card later with reveal settles it.
+ *
+ * With the map's connections set, it also knows how many actions apart any
+ * two cities are, counting shuttles between research stations.
+ *
+ * The state is hashed as it changes, card by card, and the analyses keep
+ * their results in a cache keyed by that hash, shared by every copy of the
+ * tracker, so coming back to a state doesn't work anything out again.
+ */
+class Tracker
+{
+public:
+	// OVER_RATE is a turn infecting more cards than the infection rate,
+	// BAD_ARGUMENT a player out of range or a turn with the wrong number of
+	// player cards
+	enum status_t {OK = 0, AMBIGUOUS, INVALID, NOT_IN_PILE, EMPTY_DECK,
+				   OVER_RATE, BAD_ARGUMENT};
+
+	struct result_t
+	{
+		status_t status;
+		const card_t *card;
+	};
+
+	// turns of play the risk rankings look ahead
+	static const int risk_horizon = 3;
+	static const int cards_to_cure = 5;
+	static const int cards_per_turn = 2;
+	// players are numbered up to this, as many as the console takes
+	static const int max_player = 999;
+
+	Tracker(deck_t cities, const std::vector<std::string> &events,
+			int initial_draws, int epidemics);
+
+	// cards whose names start with name
+	std::pair<deck_t::const_iterator, deck_t::const_iterator>
+		matches(const std::string &name) const;
+	result_t resolve(const std::string &name) const;
+
+	result_t draw(const std::string &name);
+	result_t undraw(const std::string &name);
+	result_t infect(const std::string &name);
+	result_t uninfect(const std::string &name);
+	result_t epidemic(const std::string &name);
+	result_t unepidemic(const std::string &name);
+	result_t resilient_population(const std::string &name);
+
+	// research stations, which players can shuttle between
+	result_t build_station(const std::string &name);
+	result_t remove_station(const std::string &name);
+	// reads the map, so routes() can tell how far apart cities are, or with
+	// more cities and events than a route table holds leaves it without one
+	bool set_connections(const connections_t &connections);
+
+	// a card nobody saw taken from the top of the player or infection deck
+	result_t draw_unknown();
+	result_t undraw_unknown();
+	result_t infect_unknown();
+	result_t uninfect_unknown();
+	// names a card that was one of those taken unseen from PLAYER_DECK or
+	// INFECTION_DECK
+	result_t reveal(pile_t from, const std::string &name);
+	pile_odds_t pile_odds(const card_t &card) const;
+
+	// moves a drawn card into the hand of a player from 0 to max_player, from
+	// another hand if need be
+	result_t give(int player, const std::string &name);
+	// takes a card out of whichever hand holds it
+	result_t discard(const std::string &name);
+
+	// puts the named cards on top of the infection deck, first card on top
+	result_t forecast(const std::vector<std::string> &names);
+
+	// a player's turn, logged in one go. An empty name is a card nobody saw.
+	struct turn_t
+	{
+		// hand the drawn cards go to, if any
+		int player = -1;
+		// with the epidemics, two cards unless they're the last in the deck
+		std::vector<std::string> draws;
+		// bottom cards of the infection deck the epidemics drawn infected
+		std::vector<std::string> epidemics;
+		// no more than the infection rate after the epidemics
+		std::vector<std::string> infections;
+	};
+
+	// what became of a turn, with the name that stopped it if it failed
+	struct turn_result_t
+	{
+		result_t result;
+		const std::string *input;
+	};
+
+	// plays a whole turn or, if any of it fails, none of it, and moves the
+	// infection rate track on a turn
+	turn_result_t turn(const turn_t &turn);
+
+	// ranks orderings of the named top cards by risk, best first
+	result_t forecast_best(const std::vector<std::string> &names, size_t keep,
+						   std::vector<ranked_forecast_t> &ranked) const;
+	// ranks the infection discard by how much removing each card saves
+	std::vector<std::pair<double, const card_t *>> resilient_best() const;
+
+	// chance each color is cured within turns player turns, assuming the
+	// cards drawn can be pooled with the hand holding most of that color.
+	// Cached per color on the counts its odds depend on, so a card given or
+	// discarded recomputes its color alone while a draw, changing the deck,
+	// recomputes them all. Turns past the end of the deck count as drawing
+	// the rest of it.
+	cure_odds_t cure_odds(int turns) const;
+
+	// draw counts bounding the window the next epidemic is in
+	std::pair<int, int> epidemic_window() const;
+	// the same for any epidemic, 0 being the first
+	std::pair<int, int> epidemic_window(int epidemic) const;
+
+	// Zobrist hash of every pile, hand, cube count and counter
+	uint64_t state_hash() const;
+	ResultCache& cache() const { return *cache_; }
+
+	// what's wrong with the tracked state, or nothing if it's sound. Searching
+	// the route table over is most of the work, so it can be left out when
+	// no station has moved.
+	std::string check(bool routes = true) const;
+
+	const deck_t& cities() const { return cities_; }
+	const deck_t& player_deck() const { return player_deck_; }
+	const deck_t& player_drawn() const { return player_drawn_; }
+	// strata of the infection deck, the top of the deck at the back
+	const std::vector<deck_t>& infection_deck() const { return infection_deck_; }
+	const deck_t& infection_discard() const { return infection_discard_; }
+	const deck_t& infection_removed() const { return infection_removed_; }
+	const std::map<int, deck_t>& hands() const { return hands_; }
+	const deck_t& stations() const { return stations_; }
+	// travel distances, empty until the connections are set. Cities are
+	// numbered by index().
+	const RouteMap& routes() const { return routes_; }
+	// a card's place in cities()
+	int index(const card_t &card) const;
+	// cards of the player deck and of each stratum taken unseen
+	int unknown_draws() const { return unknown_draws_; }
+	const std::vector<int>& unknown_infects() const { return unknown_infects_; }
+
+	// cubes logged against a city, used to weigh infection risk
+	int cubes(const std::string &city) const;
+
+	int n_draws() const { return n_draws_; }
+	int total_cards() const { return total_cards_; }
+	int current_epidemics() const { return current_epidemics_; }
+	// cards infected so far, and how many the turns played should have
+	int n_infects() const { return n_infects_; }
+	int expected_infects() const { return expected_infects_; }
+	int initial_draws() const { return initial_draws_; }
+	int epidemics() const { return epidemics_; }
+	int cards_per_epidemic() const { return cards_per_epidemic_; }
+	int big_stacks() const { return big_stacks_; }
+
+private:
+	risk_model_t risk_model() const;
+	// each card's hash key in each place it can be
+	static uint64_t card_key(const std::string &card, int place);
+	void toggle(const std::string &card, int place) { hash_ ^= card_key(card, place); }
+	void add_cubes(const std::string &city, int n);
+	// works the hash of the piles out from scratch
+	uint64_t pile_hash() const;
+	// moves the rest of a pile on once its listed cards are all gone unseen
+	void settle_draws();
+	void settle_infects();
+	// the same as the named versions, for a card out of cities_
+	result_t draw(const card_t &city);
+	result_t infect(const card_t &city);
+	result_t epidemic(const card_t &city);
+	result_t give(int player, const card_t &city);
+	result_t discard(const card_t &city);
+	// whether a turn would go through, without playing it, with the cards it
+	// plays in order, null for those unseen
+	turn_result_t check_turn(const turn_t &turn,
+							 std::vector<const card_t *> &cards) const;
+
+	struct cure_cache_t
+	{
+		int turns = -1;
+		int n_draws = 0;
+		int current_epidemics = 0;
+		// chance of drawing each number of epidemics in the next turns
+		std::vector<double> epidemics;
+		// the deck size, unknown draws, color's count in the deck and most
+		// held in a hand each color's odds were worked out from
+		std::array<std::tuple<int, int, int, int>, EVENT> inputs;
+		cure_odds_t odds;
+		// copies of the tracker share the cache, so it's locked to use
+		std::mutex mutex;
+	};
+
+	deck_t cities_;
+	deck_t player_deck_;
+	deck_t player_drawn_;
+	std::vector<deck_t> infection_deck_;
+	std::vector<int> unknown_infects_;
+	// strata with unknown cards an epidemic shuffled into the new top
+	// stratum, by their position, so unepidemic can put them back
+	std::vector<std::vector<std::tuple<size_t, deck_t, int>>> folds_;
+	deck_t infection_discard_;
+	deck_t infection_removed_;
+	std::map<std::string, int> cubes_;
+	std::map<int, deck_t> hands_;
+	deck_t stations_;
+	RouteMap routes_;
+	// cards of each color left in player_deck_
+	std::array<int, N_COLORS> deck_counts_ = {};
+	std::shared_ptr<cure_cache_t> cure_cache_;
+
+	int initial_draws_;
+	int epidemics_;
+	int total_cards_;
+	int cards_per_epidemic_;
+	int big_stacks_;
+	int n_draws_;
+	int unknown_draws_ = 0;
+	uint64_t hash_ = 0;
+	std::shared_ptr<ResultCache> cache_;
+	int n_infects_ = 0;
+	// the nine cards infected at setup, then the rate each turn
+	int expected_infects_ = 9;
+	int current_epidemics_ = 0;
+};
+
+#endif
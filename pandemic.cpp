@@ -10,8 +10,18 @@
 #include <algorithm>
 #include <readline/readline.h>
 #include <csignal>
+#include <random>
+#include <chrono>
+#include <set>
+#include <unistd.h>
 
 #include "Console.hpp"
+#include "Tracker.hpp"
+#include "pandemic.h"
+#include "Records.hpp"
+#include "Follow.hpp"
+#include "Cache.hpp"
+#include "Simulation.hpp"
 
 using namespace CppReadline;
 
@@ -29,48 +39,7 @@ const char * commands[] = {
 	[CARD_STATS] = "card_stats"
 };
 
-enum color_t {YELLOW = 0, RED, BLUE, BLACK, EVENT, N_COLORS};
-color_t to_color(const std::string &str);
-std::string color_to_string(color_t color);
-
-const char * colors[] = {
-	[YELLOW] = "yellow",
-	[RED] = "red",
-	[BLUE] = "blue",
-	[BLACK] = "black",
-	[EVENT] = "event"
-};
-
-class LazyString: public std::string
-{
-public:
-	using std::string::string;
-	LazyString(const std::string &s): std::string(s) {}
-};
-
-bool operator== (const LazyString &lhs, const LazyString &rhs)
-{
-	for(int i = 0; i < std::min(lhs.size(), rhs.size()); i++)
-		if(tolower(lhs[i]) != tolower(rhs[i])) return false;
-	
-	return true;
-}
-
-bool operator< (const LazyString &lhs, const LazyString &rhs)
-{
-	for(int i = 0; i < std::min(lhs.size(), rhs.size()); i++)
-	{
-		if(tolower(lhs[i]) < tolower(rhs[i])) return true;
-		else if(tolower(lhs[i]) > tolower(rhs[i])) return false;
-	}
-	
-	return false;
-}
-
-using deck_t = std::map<LazyString, color_t>;
-
 int run(std::istream &in);
-deck_t load_cities(const std::string &filename);
 
 template<class T>
 std::istream& operator>> (std::istream &in, std::vector<T> &v)
@@ -143,27 +112,51 @@ int run(const std::string &script)
 	auto cities = load_cities(city_file);
 	std::cout << cities.size() << " cities loaded" << std::endl;
 	
-	std::vector<decltype(cities)> infection_deck{cities};
-	decltype(cities) infection_discard;
+	// the map's connections live beside the cities
+	auto connections = load_connections(
+		city_file.substr(0, city_file.rfind('/') + 1) + "adjacency.txt");
+	if(!connections.empty())
+		std::cout << connections.size() << " connections loaded" << std::endl;
+	
+	auto new_game = [&]()
+	{
+		Tracker ret(cities, events, initial_draws, epidemics);
+		if(!connections.empty())
+		{
+			ret.set_connections(connections);
+			// every game starts with a research station in Atlanta
+			ret.build_station("Atlanta");
+		}
+		return ret;
+	};
 	
-	for(auto event : events)
-		cities.insert(std::make_pair(event, EVENT));
+	Tracker tracker = new_game();
+	if(!connections.empty() && tracker.routes().empty())
+		std::cout << "error: Routes only go between up to "
+				  << RouteMap::max_cities << " cities and events" << std::endl;
+	RecordWriter records(std::cout);
 	
-	int total_cards = cities.size() - initial_draws + epidemics;
-	int cards_per_epidemic = total_cards / epidemics;
-	int big_stacks = total_cards - cards_per_epidemic * epidemics;
-	int n_draws = -8;
-	int n_infects = 0;
-	int expected_infects = 9;
-	int current_epidemics = 0;
+	// errors that aren't about a card
+	auto report_error = [&records](const std::string &message)
+	{
+		if(records.structured())
+			records.error(message);
+		else
+			std::cout << message << std::endl;
+	};
 	
-	auto player_deck(cities);
-	decltype(player_deck) player_drawn;
+	// a card name a lookup couldn't resolve, as an error since nothing happened
+	auto unresolved_error = [&records](const std::string &name,
+									   Tracker::result_t result)
+	{
+		records.error(name + (result.status == Tracker::AMBIGUOUS?
+							  " was ambiguous" : " is an invalid card"));
+	};
 	
 	// used to check ambiguous cards
-	auto ambig = [&cities](const std::string &draw)
+	auto ambig = [&tracker](const std::string &draw)
 	{
-		auto range = cities.equal_range(draw);
+		auto range = tracker.matches(draw);
 		int ret = 0;
 		if((ret = std::distance(range.first, range.second)) > 1)
 		{
@@ -181,10 +174,20 @@ int run(const std::string &script)
 		return ret;
 	};
 	
+	// stands in for a card taken without anyone seeing which
+	const std::string unknown_card = "?";
+	
+	// player numbers are small non-negative integers, so they can't be cards
+	auto is_player = [](const std::string &arg)
+	{
+		return !arg.empty() && arg.size() < 4 &&
+			std::all_of(arg.begin(), arg.end(), ::isdigit);
+	};
+	
 	// handles completion
-	Console::registerArgCompletionFunction([&cities](const std::string &text)
+	Console::registerArgCompletionFunction([&tracker](const std::string &text)
 	{
-		auto range = cities.equal_range(text);
+		auto range = tracker.matches(text);
 		std::vector<std::string> ret;
 		if(std::distance(range.first, range.second) > 1)
 			ret.push_back("");
@@ -212,17 +215,33 @@ int run(const std::string &script)
 		Console::Arguments infects(args.begin() + 1, args.end());
 		for(const auto &infect : infects)
 		{
-			if(ambig(infect) != 1) continue;
+			auto command = [&]()
+			{
+				return infect == unknown_card? tracker.infect_unknown() :
+					tracker.infect(infect);
+			};
+			
+			if(records.structured())
+			{
+				records.card(tracker, RecordWriter::INFECT, infect, command());
+				continue;
+			}
+			
+			if(infect != unknown_card && ambig(infect) != 1) continue;
 			
-			if(auto card = infection_deck.back().find(infect);
-				card != infection_deck.back().end())
+			auto result = command();
+			if(result.status == Tracker::EMPTY_DECK)
+			{
+				std::cout << "error: The infection deck is empty." << std::endl;
+				break;
+			}
+			else if(result.status == Tracker::OK && !result.card)
+			{
+				std::cout << "Infecting an unknown card" << std::endl;
+			}
+			else if(result.status == Tracker::OK)
 			{
-				std::cout << "Infecting: " << *card << std::endl;
-				infection_discard.insert(std::move(*card));
-				n_infects++;
-				infection_deck.back().erase(card);
-				if(infection_deck.back().size() == 0)
-					infection_deck.pop_back();
+				std::cout << "Infecting: " << *result.card << std::endl;
 			}
 			else
 			{
@@ -238,16 +257,30 @@ int run(const std::string &script)
 		Console::Arguments infects(args.begin() + 1, args.end());
 		for(const auto &infect : infects)
 		{
+			if(infect == unknown_card)
+			{
+				auto result = tracker.uninfect_unknown();
+				if(records.structured())
+					records.card(tracker, RecordWriter::UNINFECT, infect, result);
+				else if(result.status == Tracker::OK)
+					std::cout << "Uninfecting an unknown card" << std::endl;
+				else
+					std::cout << "error: No unknown infections on top" << std::endl;
+				continue;
+			}
+			
+			if(records.structured())
+			{
+				records.card(tracker, RecordWriter::UNINFECT, infect,
+							 tracker.uninfect(infect));
+				continue;
+			}
+			
 			if(ambig(infect) != 1) continue;
 			
-			if(auto card = infection_discard.find(infect);
-				card != infection_discard.end())
+			if(auto result = tracker.uninfect(infect); result.status == Tracker::OK)
 			{
-				std::cout << "Uninfecting: " << *card << std::endl;
-				infection_deck.back().insert(std::move(*card));
-				infection_discard.erase(card);
-				if(infection_discard.size() == 0)
-					infection_deck.pop_back();
+				std::cout << "Uninfecting: " << *result.card << std::endl;
 			}
 			else
 			{
@@ -258,31 +291,60 @@ int run(const std::string &script)
 		return 0;
 	});
 	
+	// draw [player] cards..., putting the cards in the player's hand if given
 	console.registerCommand("draw", [&](const Console::Arguments &args)
 	{
-		Console::Arguments draws(args.begin() + 1, args.end());
+		auto first = args.begin() + 1;
+		int player = -1;
+		if(first != args.end() && is_player(*first))
+			player = std::stoi(*first++);
+		
+		Console::Arguments draws(first, args.end());
 		for(const auto &draw : draws)
 		{
+			if(draw == unknown_card)
+			{
+				auto result = tracker.draw_unknown();
+				if(records.structured())
+					records.card(tracker, RecordWriter::DRAW, draw, result);
+				else if(result.status == Tracker::OK)
+					std::cout << "Drew an unknown card" << std::endl;
+				else
+					std::cout << "error: The player deck is empty" << std::endl;
+				continue;
+			}
+			
+			if(records.structured())
+			{
+				auto result = tracker.draw(draw);
+				records.card(tracker, RecordWriter::DRAW, draw, result);
+				if(result.status == Tracker::OK && player >= 0)
+					records.card(tracker, RecordWriter::GIVE, draw,
+								 tracker.give(player, draw));
+				continue;
+			}
+			
 			if(ambig(draw) != 1) continue;
 			
-			if(auto card = player_deck.find(draw);
-				card != player_deck.end())
+			if(auto result = tracker.draw(draw); result.status == Tracker::OK)
 			{
-				std::cout << "Drew " << *card << std::endl;
-				player_drawn.insert(std::move(*card));
-				player_deck.erase(card);
-				n_draws++;
+				std::cout << "Drew " << *result.card;
+				if(player >= 0 && tracker.give(player, draw).status == Tracker::OK)
+					std::cout << " into player " << player << "'s hand";
+				std::cout << std::endl;
 			}
 			else
 			{
-				std::cout << "error: " << *player_drawn.find(draw);
+				std::cout << "error: " << *result.card;
 				std::cout << " was already drawn" << std::endl;
 			}
 		}
 		
-		std::cout << n_draws << " draws so far." << std::endl;
+		if(!records.structured())
+			std::cout << tracker.n_draws() << " draws so far." << std::endl;
 		
-		return 0;
+		return static_cast<Console::ReturnCode>
+					(console.executeCommand("cure_odds"));
 	});
 	
 	console.registerCommand("undraw", [&](const Console::Arguments &args)
@@ -290,253 +352,1326 @@ int run(const std::string &script)
 		Console::Arguments draws(args.begin() + 1, args.end());
 		for(const auto &draw : draws)
 		{
+			if(draw == unknown_card)
+			{
+				auto result = tracker.undraw_unknown();
+				if(records.structured())
+					records.card(tracker, RecordWriter::UNDRAW, draw, result);
+				else if(result.status == Tracker::OK)
+					std::cout << "Undrew an unknown card" << std::endl;
+				else
+					std::cout << "error: No unknown cards were drawn" << std::endl;
+				continue;
+			}
+			
+			if(records.structured())
+			{
+				records.card(tracker, RecordWriter::UNDRAW, draw,
+							 tracker.undraw(draw));
+				continue;
+			}
+			
 			if(ambig(draw) != 1) continue;
 			
-			if(auto card = player_drawn.find(draw);
-				card != player_drawn.end())
+			if(auto result = tracker.undraw(draw); result.status == Tracker::OK)
 			{
-				std::cout << "Undrew " << *card << std::endl;
-				player_deck.insert(std::move(*card));
-				player_drawn.erase(card);
-				n_draws--;
+				std::cout << "Undrew " << *result.card << std::endl;
 			}
 			else
 			{
-				std::cout << "error: " << *player_deck.find(draw);
+				std::cout << "error: " << *result.card;
 				std::cout << " hasn't been drawn yet" << std::endl;
 			}
 		}
 		
-		std::cout << n_draws << " draws so far." << std::endl;
+		if(!records.structured())
+			std::cout << tracker.n_draws() << " draws so far." << std::endl;
 		
-		return 0;
+		return static_cast<Console::ReturnCode>
+					(console.executeCommand("cure_odds"));
 	});
 	
-	console.registerCommand("epidemic", [&](const Console::Arguments &infections)
+	console.registerCommand("give", [&](const Console::Arguments &args)
 	{
-		current_epidemics++;
-		n_draws++;
-		std::cout << "Epidemic " << current_epidemics << std::endl;
-		std::string infection;
-		if(infections.size() > 1)
-			infection = infections[1];
+		if(args.size() < 3 || !is_player(args[1]))
+		{
+			report_error("usage: give <player> <drawn cards>");
+			return Console::Error;
+		}
 		
-		while(true)
+		int player = std::stoi(args[1]);
+		Console::Arguments gives(args.begin() + 2, args.end());
+		for(const auto &give : gives)
 		{
-			while(infection.empty() || ambig(infection) != 1)
+			if(records.structured())
 			{
-				std::cout << "(infect from bottom) ";
-				in >> infection;
+				records.card(tracker, RecordWriter::GIVE, give,
+							 tracker.give(player, give));
+				continue;
 			}
 			
-			if(infection_deck.front().count(infection) == 0)
-				std::cout << "error: That card is not in the bottom deck" << std::endl;
+			if(ambig(give) != 1) continue;
+			
+			if(auto result = tracker.give(player, give); result.status == Tracker::OK)
+			{
+				std::cout << "Gave " << *result.card << " to player ";
+				std::cout << player << std::endl;
+			}
 			else
-				break;
+			{
+				std::cout << "error: " << *result.card;
+				std::cout << " hasn't been drawn yet" << std::endl;
+			}
 		}
 		
-		auto card = infection_deck.front().find(infection);
-		std::cout << "Infecting " << *card << std::endl;
-		infection_discard.insert(std::move(*card));
-		infection_deck.push_back(std::move(infection_discard));
-		infection_discard.clear();
-		
-		return console.executeCommand("epidemic_stats");
+		return static_cast<Console::ReturnCode>
+					(console.executeCommand("cure_odds"));
 	});
 	
-	console.registerCommand("unepidemic", [&](const Console::Arguments &infections)
+	console.registerCommand("discard", [&](const Console::Arguments &args)
 	{
-		current_epidemics--;
-		n_draws--;
-		std::cout << "Epidemic " << current_epidemics << std::endl;
-		std::string infection;
-		if(infections.size() > 1)
-			infection = infections[1];
-		
-		while(true)
+		Console::Arguments discards(args.begin() + 1, args.end());
+		for(const auto &discard : discards)
 		{
-			if(!infection.empty() && infection_deck.back().count(infection) == 0)
-				std::cout << "error: That card is not on top of the infect deck" << std::endl;
-			else if(!infection.empty())
-				break;
+			if(records.structured())
+			{
+				records.card(tracker, RecordWriter::DISCARD, discard,
+							 tracker.discard(discard));
+				continue;
+			}
+			
+			if(ambig(discard) != 1) continue;
 			
-			do
+			if(auto result = tracker.discard(discard); result.status == Tracker::OK)
 			{
-				std::cout << "uninfect from bottom: ";
-				in >> infection;
-			} while(infection.empty() || ambig(infection) != 1);
+				std::cout << "Discarded " << *result.card << std::endl;
+			}
+			else
+			{
+				std::cout << "error: " << *result.card;
+				std::cout << " isn't in anyone's hand" << std::endl;
+			}
 		}
 		
-		auto card = infection_deck.back().find(infection);
-		std::cout << "Uninfecting " << *card << std::endl;
-		infection_deck.front().insert(std::move(*card));
-		std::copy(infection_deck.back().begin(), infection_deck.back().end(),
-			std::inserter(infection_discard, infection_discard.begin()));
-		infection_deck.pop_back();
-		
-		return console.executeCommand("epidemic_stats");
+		return static_cast<Console::ReturnCode>
+					(console.executeCommand("cure_odds"));
 	});
 	
-	console.registerCommand("epidemic_stats", [&](const Console::Arguments&)
+	// reveal <draw|infect> cards..., naming cards that were taken unseen
+	console.registerCommand("reveal", [&](const Console::Arguments &args)
 	{
-		std::cout << "Epidemics so far: " << current_epidemics << std::endl;
-		std::cout << "Draws left: " << total_cards - n_draws << std::endl;
-		std::cout << "Turns left: " << (total_cards - n_draws) / 2 << std::endl;
-		int safe_phase = 0;
-		if(current_epidemics < big_stacks)
-			safe_phase = current_epidemics * (cards_per_epidemic + 1);
-		else
-			safe_phase = big_stacks * (cards_per_epidemic + 1) +
-				(current_epidemics - big_stacks) * cards_per_epidemic;
-		
-		int next_phase = safe_phase + 
-					cards_per_epidemic + (current_epidemics < big_stacks);
-		
-		if(n_draws + 2 <= safe_phase)
+		if(args.size() < 3 || (args[1] != "draw" && args[1] != "infect"))
 		{
-			std::cout << "No epidemics for " << safe_phase - n_draws;
-			std::cout << " more draws. (" << (safe_phase - n_draws) / 2;
-			std::cout << " turns)" << std::endl;
+			report_error("usage: reveal <draw|infect> <cards>");
+			return Console::Error;
 		}
-		else if(n_draws + 2 <= next_phase)
+		
+		bool draw = args[1] == "draw";
+		auto pile = draw? PLAYER_DECK : INFECTION_DECK;
+		auto op = draw? RecordWriter::REVEAL_DRAW : RecordWriter::REVEAL_INFECT;
+		Console::Arguments reveals(args.begin() + 2, args.end());
+		for(const auto &reveal : reveals)
 		{
-			std::cout << "Epidemic is in the next " << next_phase - n_draws;
-			std::cout << " draws (" << 200.0 / (next_phase - n_draws);
-			std::cout << "% chance to draw this turn) " << std::endl;
+			if(records.structured())
+			{
+				records.card(tracker, op, reveal, tracker.reveal(pile, reveal));
+				continue;
+			}
+			
+			if(ambig(reveal) != 1) continue;
+			
+			if(auto result = tracker.reveal(pile, reveal); result.status == Tracker::OK)
+			{
+				std::cout << (draw? "Drew " : "Infected ") << *result.card;
+				std::cout << " earlier" << std::endl;
+			}
+			else
+			{
+				std::cout << "error: " << *result.card << " can't have been ";
+				std::cout << (draw? "drawn" : "infected") << " unseen" << std::endl;
+			}
 		}
-		else if(n_draws + 1 == next_phase)
+		
+		return Console::Ok;
+	});
+	
+	console.registerCommand("pile_odds", [&](const Console::Arguments &args)
+	{
+		Console::Arguments cards(args.begin() + 1, args.end());
+		for(const auto &card : cards)
 		{
-			std::cout << "Epidemic will be the next card drawn, ";
-			std::cout << "followed by a 1/";
-			std::cout << (cards_per_epidemic + (current_epidemics < big_stacks));
-			std::cout << " chance of drawing another after" << std::endl;
+			auto result = tracker.resolve(card);
+			if(records.structured())
+			{
+				if(result.status == Tracker::OK)
+					records.pile_odds(tracker, result.card,
+									  tracker.pile_odds(*result.card));
+				else
+					unresolved_error(card, result);
+				continue;
+			}
+			
+			if(ambig(card) != 1) continue;
+			
+			auto odds = tracker.pile_odds(*result.card);
+			std::cout << *result.card << ":";
+			for(int pile = 0; pile < N_PILES; pile++)
+				if(odds[pile] > 0.0)
+					std::cout << " " << 100 * odds[pile] << "% " <<
+						pile_to_string(pile_t(pile));
+			std::cout << std::endl;
 		}
 		
 		return 0;
 	});
 	
-	console.registerCommand("infect_stats", [&](const Console::Arguments&)
+	console.registerCommand("hands", [&](const Console::Arguments&)
 	{
-		std::cout << "Infection Discard: {";
-		for(auto i : infection_discard)
-			std::cout << i << ", ";
-		std::cout << "}\n" << std::endl;
+		if(records.structured())
+		{
+			records.hands(tracker);
+			return 0;
+		}
 		
-		std::cout << "The next infections are:" << std::endl;
-		for(auto i = infection_deck.rbegin(); i != infection_deck.rend(); ++i)
+		for(const auto &[player, hand] : tracker.hands())
 		{
-			std::cout << "{";
-			for(auto j : *i)
-				std::cout << j << ", ";
-			std::cout << "}\n" << std::endl;
+			std::cout << "Player " << player << ": {";
+			for(const auto &card : hand)
+				std::cout << card << ", ";
+			std::cout << "}" << std::endl;
 		}
 		
 		return 0;
 	});
 	
-	console.registerCommand("card_stats", [&](const Console::Arguments&)
+	// cure_odds [turns], the chance of holding each cure within the turns
+	console.registerCommand("cure_odds", [&](const Console::Arguments& args)
 	{
-		std::cout << "Cards left in player deck: {";
-		int counts[N_COLORS] = {0};
-		for(auto card : player_deck)
+		int turns = args.size() > 1? std::atoi(args[1].c_str()) : 4;
+		if(turns < 0 || turns > 0xff)
 		{
-			++counts[card.second];
-			std::cout << card << ", ";
+			report_error("usage: cure_odds [turns]");
+			return Console::Error;
 		}
-		std::cout << "}\n" << std::endl;
 		
-		for(int color = 0; color < N_COLORS; color++)
+		const auto &odds = tracker.cure_odds(turns);
+		if(records.structured())
 		{
-			std::cout << std::make_pair(std::to_string(counts[color]) + " " +
-										std::string(colors[color]),
-										color_t(color));
-			if(color < N_COLORS - 1)
+			records.cure_odds(turns, odds);
+			return Console::Ok;
+		}
+		
+		std::cout << "Cure odds within " << turns << " turns: ";
+		for(int color = 0; color < EVENT; color++)
+		{
+			std::ostringstream percent;
+			percent.precision(3);
+			percent << 100 * odds[color] << "% " << color_to_string(color_t(color));
+			std::cout << std::make_pair(percent.str(), color_t(color));
+			if(color < EVENT - 1)
 				std::cout << ", ";
 		}
 		std::cout << std::endl;
-		return 0;
+		return Console::Ok;
 	});
 	
-	console.registerCommand("forecast", [&](const Console::Arguments& args)
+	auto station_command = [&](RecordWriter::op_t op, bool build)
 	{
-		Console::Arguments nexts(args.begin() + 1, args.end());
-		std::vector<deck_t::value_type> forecast;
-		for(const auto &next: nexts)
+		return [&, op, build](const Console::Arguments &args)
 		{
-			if(ambig(next) != 1)
+			Console::Arguments stations(args.begin() + 1, args.end());
+			for(const auto &station : stations)
 			{
-				console.executeCommand("infect_stats");
+				auto command = [&]()
+				{
+					return build? tracker.build_station(station) :
+						tracker.remove_station(station);
+				};
+				
+				if(records.structured())
+				{
+					records.card(tracker, op, station, command());
+					continue;
+				}
+				
+				if(ambig(station) != 1) continue;
+				
+				auto result = command();
+				if(result.status == Tracker::OK)
+					std::cout << (build? "Built a research station in " :
+								  "Removed the research station in ") << *result.card;
+				else if(result.status == Tracker::INVALID)
+					std::cout << "error: " << *result.card << " isn't a city";
+				else
+					std::cout << "error: " << *result.card << (build?
+						" already has a research station" : " has no research station");
+				std::cout << std::endl;
+			}
+			
+			return Console::Ok;
+		};
+	};
+	
+	console.registerCommand("station",
+							station_command(RecordWriter::STATION, true));
+	console.registerCommand("unstation",
+							station_command(RecordWriter::UNSTATION, false));
+	
+	/* Actions from one city to another, driving and shuttling between
+	 * stations, or to every city if only one is given.
+	 */
+	console.registerCommand("route", [&](const Console::Arguments& args)
+	{
+		const auto &routes = tracker.routes();
+		if(routes.empty())
+		{
+			report_error("No map: put adjacency.txt beside the cities file");
+			return Console::Error;
+		}
+		if(args.size() < 2 || args.size() > 3)
+		{
+			report_error("usage: route <from> [to]");
+			return Console::Error;
+		}
+		
+		std::vector<const card_t *> ends;
+		for(auto arg = args.begin() + 1; arg != args.end(); ++arg)
+		{
+			auto result = tracker.resolve(*arg);
+			if(result.status != Tracker::OK)
+			{
+				if(records.structured())
+					unresolved_error(*arg, result);
+				else
+					ambig(*arg);
 				return Console::Error;
 			}
+			ends.push_back(result.card);
+		}
+		
+		int from = tracker.index(*ends.front());
+		if(ends.size() == 1)
+		{
+			if(records.structured())
+			{
+				records.distances(tracker, from);
+				return Console::Ok;
+			}
+			
+			// grouped by how far away they are
+			std::map<int, std::vector<const card_t *>> by_distance;
+			int to = 0;
+			for(const auto &card : tracker.cities())
+				if(int actions = routes.distance(from, to++);
+				   actions != RouteMap::unreachable)
+					by_distance[actions].push_back(&card);
+			
+			for(const auto &[actions, cards] : by_distance)
+			{
+				std::cout << actions << ":";
+				for(const auto *card : cards)
+					std::cout << " " << *card;
+				std::cout << std::endl;
+			}
+			return Console::Ok;
+		}
+		
+		int to = tracker.index(*ends.back());
+		auto path = routes.route(from, to);
+		if(records.structured())
+		{
+			records.route(tracker, from, to, path);
+			return Console::Ok;
+		}
+		
+		if(path.empty())
+		{
+			std::cout << "No way from " << *ends.front() << " to ";
+			std::cout << *ends.back() << std::endl;
+			return Console::Ok;
+		}
+		
+		std::cout << routes.distance(from, to) << " actions:";
+		for(size_t i = 0; i < path.size(); i++)
+		{
+			int city = path[i];
+			std::cout << (i? " -> " : " ") << *std::next(tracker.cities().begin(), city);
+		}
+		std::cout << std::endl;
+		return Console::Ok;
+	});
+	
+	/* A whole turn at once: turn [player] <draws> [epidemic <card>]...
+	 * [infect <cards>]. Either all of it is logged or, if any card is wrong,
+	 * none of it.
+	 */
+	console.registerCommand("turn", [&](const Console::Arguments& args)
+	{
+		Tracker::turn_t turn;
+		auto arg = args.begin() + 1;
+		if(arg != args.end() && is_player(*arg))
+			turn.player = std::stoi(*arg++);
+		
+		auto *events = &turn.draws;
+		for(; arg != args.end(); ++arg)
+		{
+			if(*arg == "infect")
+			{
+				events = &turn.infections;
+				continue;
+			}
 			
-			if(auto card = infection_deck.back().find(next);
-				card != infection_deck.back().end())
+			if(*arg == "epidemic" && events == &turn.draws)
 			{
-				forecast.push_back(std::move(*card));
-				infection_deck.back().erase(card);
-				if(infection_deck.back().size() == 0)
-					infection_deck.pop_back();
+				if(++arg == args.end())
+				{
+					report_error("usage: turn [player] <draws> "
+								 "[epidemic <card>]... [infect <cards>]");
+					return Console::Error;
+				}
+				turn.epidemics.push_back(*arg);
+				continue;
 			}
+			
+			events->push_back(*arg == unknown_card? "" : *arg);
+		}
+		
+		auto result = tracker.turn(turn);
+		if(records.structured())
+		{
+			records.turn(tracker, turn, result);
+			return result.result.status == Tracker::OK? Console::Ok : Console::Error;
+		}
+		
+		if(result.result.status != Tracker::OK)
+		{
+			auto in = [&](const std::vector<std::string> &events)
+			{
+				return result.input >= events.data() &&
+					result.input < events.data() + events.size();
+			};
+			
+			// a turn short of cards has no name to blame
+			const auto &input = result.input? *result.input : unknown_card;
+			auto name = input.empty()? unknown_card : input;
+			int rate = infection_rate(tracker.current_epidemics() +
+									  turn.epidemics.size());
+			if(result.result.status == Tracker::BAD_ARGUMENT)
+				std::cout << "error: A turn draws " << Tracker::cards_per_turn
+						  << " player cards, epidemics included"
+						  << (result.input? ", so " + name + " is one too many" : "")
+						  << std::endl;
+			else if(result.result.status == Tracker::OVER_RATE)
+				std::cout << "error: Too many infections for the rate of " << rate
+						  << " at " << name << std::endl;
+			else if(result.result.status == Tracker::EMPTY_DECK)
+				std::cout << "error: The deck is empty at " << name << std::endl;
+			else if(result.result.status == Tracker::NOT_IN_PILE)
+				std::cout << "error: " << *result.result.card << (in(turn.draws)?
+					" was already drawn" : in(turn.epidemics)?
+					" is not at the bottom of the deck" :
+					" is not at the top of the deck") << std::endl;
 			else
+				ambig(input);
+			std::cout << "Nothing was logged" << std::endl;
+			return Console::Error;
+		}
+		
+		auto list = [&](const char *what, const std::vector<std::string> &names)
+		{
+			std::cout << what;
+			for(size_t i = 0; i < names.size(); i++)
 			{
-				std::cout << "error: " << next;
-				std::cout << " is not at the top of the deck." << std::endl;
-				console.executeCommand("infect_stats");
-				return Console::Error;
+				std::cout << (i? ", " : " ");
+				if(names[i].empty())
+					std::cout << "an unknown card";
+				else
+					std::cout << *tracker.resolve(names[i]).card;
 			}
+		};
+		
+		list("Drew", turn.draws);
+		if(turn.player >= 0)
+			std::cout << " into player " << turn.player << "'s hand";
+		std::cout << std::endl;
+		if(!turn.epidemics.empty())
+		{
+			list("Epidemic infecting", turn.epidemics);
+			std::cout << std::endl;
 		}
+		list("Infected", turn.infections);
+		std::cout << std::endl;
 		
-		for(auto ri = forecast.rbegin(); ri != forecast.rend(); ++ri)
-			infection_deck.push_back({std::move(*ri)});
+		int rate = infection_rate(tracker.current_epidemics());
+		std::cout << "Infection rate " << rate << ", " << tracker.n_infects();
+		std::cout << " of " << tracker.expected_infects() << " infections logged";
+		std::cout << std::endl;
 		
+		console.executeCommand("epidemic_stats");
 		return static_cast<Console::ReturnCode>
-					(console.executeCommand("infect_stats"));
+					(console.executeCommand("cure_odds"));
 	});
 	
-	console.registerCommand("resilient_population",
-							[&](const Console::Arguments& args)
+	/* Monte Carlo estimate of what the next turns' infections do, sampling for
+	 * up to ms milliseconds or until within precision either way. Asking again
+	 * carries on from the last estimate of the same state.
+	 */
+	console.registerCommand("simulate", [&](const Console::Arguments& args)
 	{
-		if(args.size() < 2)
+		auto query = args.size() > 1? to_query(args[1]) : InfectionSampler::N_QUERIES;
+		size_t next = 2;
+		const card_t *city = nullptr;
+		if(query == InfectionSampler::INFECTED && args.size() > next)
 		{
-			std::cout << "Too few arguments" << std::endl;
-			return Console::Error;
+			auto result = tracker.resolve(args[next]);
+			if(result.status != Tracker::OK)
+			{
+				if(records.structured())
+					unresolved_error(args[next], result);
+				else
+					ambig(args[next]);
+				return Console::Error;
+			}
+			city = result.card;
+			next++;
 		}
 		
-		auto arg = args[1];
-		if(ambig(arg) != 1)
+		int turns = args.size() > next? std::atoi(args[next].c_str()) : 3;
+		double ms = args.size() > next + 1? std::atof(args[next + 1].c_str()) : 50;
+		double precision = args.size() > next + 2? std::atof(args[next + 2].c_str()) : 0.01;
+		if(query == InfectionSampler::N_QUERIES ||
+		   (query == InfectionSampler::INFECTED && !city) ||
+		   turns < 1 || turns > 0xff || !(ms >= 0) || !(precision >= 0))
+		{
+			report_error("usage: simulate <any_outbreak|outbreaks|infected <city>> "
+						 "[turns] [ms] [precision]");
 			return Console::Error;
+		}
+		
+		auto describe = [&](const estimate_t &estimate)
+		{
+			std::cout << "\r" << query_to_string(query);
+			if(city)
+				std::cout << " " << *city;
+			std::cout << " within " << turns << " turns: " << estimate.mean;
+			std::cout << " +/- " << estimate.half_width() << " (";
+			std::cout << estimate.samples << " samples)" << std::flush;
+		};
 		
-		if(auto card = infection_discard.find(arg);
-		   card != infection_discard.end())
+		auto progress = [&](const estimate_t &estimate)
 		{
-			std::cout << "Erasing " << *card << std::endl;
-			infection_discard.erase(card);
+			if(records.structured())
+				records.estimate(tracker, query, turns, city, estimate, false);
+			else
+				describe(estimate);
+		};
+		
+		InfectionSampler sampler(tracker, query, turns, city);
+		auto estimate = simulate(tracker, sampler,
+								 std::chrono::duration<double, std::milli>(ms),
+								 precision, progress);
+		if(records.structured())
+		{
+			records.estimate(tracker, query, turns, city, estimate, true);
+			return Console::Ok;
 		}
 		
+		describe(estimate);
+		std::cout << "\x1b[K" << std::endl;
 		return Console::Ok;
 	});
 	
-	while(console.readLine() != Console::Quit)
+	/* Plays whole games against itself from the start of this game, on every
+	 * core, and sums up how they went. Policy fields and seed are set with
+	 * name=value, and out=file writes every game as binary records.
+	 */
+	console.registerCommand("selfplay", [&](const Console::Arguments& args)
 	{
-		//console.setGreeting("(pandemic"s + reminder + ")");
-	}
-	
-	return 0;
-}
-
-deck_t load_cities(const std::string &filename)
-{
-	std::ifstream in(filename);
-	deck_t ret;
+		long games = args.size() > 1? std::atol(args[1].c_str()) : 0;
+		policy_t policy;
+		uint64_t seed = (uint64_t(std::random_device{}()) << 32) ^
+			std::random_device{}();
+		std::string out_file;
+		bool usage = games < 1;
+		for(size_t i = 2; i < args.size() && !usage; i++)
+		{
+			auto equals = args[i].find('=');
+			auto name = args[i].substr(0, equals);
+			auto value = equals == std::string::npos? "" : args[i].substr(equals + 1);
+			if(name == "out")
+				out_file = value;
+			else if(name == "seed")
+				seed = std::strtoull(value.c_str(), nullptr, 10);
+			else
+				usage = value.empty() ||
+					!set_policy(policy, name, std::atof(value.c_str()));
+		}
+		
+		if(usage)
+		{
+			report_error("usage: selfplay <games> [players|treat_at|distance_weight|"
+						 "station_spacing|max_stations|hand_limit=n]... [seed=n] "
+						 "[out=file]");
+			return Console::Error;
+		}
+		if(tracker.routes().empty())
+		{
+			report_error("selfplay needs the map's connections");
+			return Console::Error;
+		}
+		
+		std::ofstream file;
+		if(!out_file.empty())
+		{
+			file.open(out_file, std::ios::binary);
+			if(!file)
+			{
+				report_error("couldn't open " + out_file);
+				return Console::Error;
+			}
+		}
+		
+		// records go to the file, or stdout if asked for structured output
+		RecordWriter game_records(file, RecordWriter::BINARY);
+		if(file.is_open())
+			game_records.cities(tracker);
+		std::function<void(const game_record_t&)> record;
+		if(file.is_open())
+			record = [&](const game_record_t &game) { game_records.game(tracker, game); };
+		else if(records.structured())
+			record = [&](const game_record_t &game) { records.game(tracker, game); };
+		
+		auto start = std::chrono::steady_clock::now();
+		auto stats = self_play(tracker, policy, games, seed, record);
+		std::chrono::duration<double> elapsed =
+			std::chrono::steady_clock::now() - start;
+		if(records.structured() && !file.is_open())
+			return Console::Ok;
+		
+		std::cout << stats.games << " games in " << elapsed.count() << "s (";
+		std::cout << stats.games / elapsed.count() << " games/sec), seed ";
+		std::cout << seed << std::endl;
+		std::cout << stats.outcomes[game_record_t::WON] << " won, lost ";
+		std::cout << stats.outcomes[game_record_t::OUTBREAKS] << " to outbreaks, ";
+		std::cout << stats.outcomes[game_record_t::CUBES] << " to cubes and ";
+		std::cout << stats.outcomes[game_record_t::CARDS];
+		std::cout << " to the player deck, ";
+		std::cout << double(stats.turns) / stats.games << " turns a game" << std::endl;
+		return Console::Ok;
+	});
+	
+	/* Starts this game over and logs a self-played game from a file into it,
+	 * the first unless another is given.
+	 */
+	console.registerCommand("replay", [&](const Console::Arguments& args)
+	{
+		if(args.size() < 2)
+		{
+			report_error("usage: replay <file> [game]");
+			return Console::Error;
+		}
+		
+		std::ifstream file(args[1], std::ios::binary);
+		uint32_t wanted = args.size() > 2? std::atol(args[2].c_str()) : 0;
+		bool any = args.size() < 3;
+		game_record_t game;
+		bool found = false;
+		while(!found && read_game(file, game))
+			found = any || game.game == wanted;
+		if(!found)
+		{
+			report_error("no such game in " + args[1]);
+			return Console::Error;
+		}
+		
+		tracker = new_game();
+		for(const auto &command : game_commands(tracker, game))
+		{
+			auto broken = console.executeCommand(command) != Console::Ok?
+				"failed" : tracker.check();
+			if(!broken.empty())
+			{
+				report_error("game " + std::to_string(game.game) + " " + broken +
+							 " at: " + command);
+				return Console::Error;
+			}
+		}
+		
+		// a card the tracker turned down doesn't fail its command
+		int draws = 0, infects = game.setup_infections.size();
+		for(const auto &turn : game.turns)
+		{
+			draws += turn.draws.size() + turn.epidemics.size();
+			infects += turn.infections.size();
+		}
+		if(tracker.n_draws() != draws || tracker.n_infects() != infects)
+		{
+			report_error("game " + std::to_string(game.game) + " logged " +
+						 std::to_string(tracker.n_draws()) + " of " +
+						 std::to_string(draws) + " draws and " +
+						 std::to_string(tracker.n_infects()) + " of " +
+						 std::to_string(infects) + " infections");
+			return Console::Error;
+		}
+		
+		if(!records.structured())
+		{
+			std::cout << "Replayed game " << game.game << ", ";
+			std::cout << outcome_to_string(game.outcome) << " after ";
+			std::cout << game.turns.size() << " turns" << std::endl;
+		}
+		return Console::Ok;
+	});
+	
+	console.registerCommand("epidemic", [&](const Console::Arguments &infections)
+	{
+		if(infections.size() < 2)
+		{
+			report_error("usage: epidemic <card from bottom>");
+			return Console::Error;
+		}
+		
+		if(records.structured())
+		{
+			auto result = tracker.epidemic(infections[1]);
+			records.card(tracker, RecordWriter::EPIDEMIC, infections[1], result);
+			if(result.status != Tracker::OK)
+				return Console::Error;
+		}
+		else if(ambig(infections[1]) != 1)
+			return Console::Error;
+		
+		else if(auto result = tracker.epidemic(infections[1]);
+				result.status != Tracker::OK)
+		{
+			std::cout << "error: That card is not in the bottom deck" << std::endl;
+			return Console::Error;
+		}
+		else
+		{
+			std::cout << "Epidemic " << tracker.current_epidemics() << std::endl;
+			std::cout << "Infecting " << *result.card << std::endl;
+		}
+		
+		return static_cast<Console::ReturnCode>
+					(console.executeCommand("epidemic_stats"));
+	});
+	
+	console.registerCommand("unepidemic", [&](const Console::Arguments &infections)
+	{
+		if(infections.size() < 2)
+		{
+			report_error("usage: unepidemic <card from top>");
+			return Console::Error;
+		}
+		
+		if(records.structured())
+		{
+			auto result = tracker.unepidemic(infections[1]);
+			records.card(tracker, RecordWriter::UNEPIDEMIC, infections[1], result);
+			if(result.status != Tracker::OK)
+				return Console::Error;
+		}
+		else if(ambig(infections[1]) != 1)
+			return Console::Error;
+		else if(auto result = tracker.unepidemic(infections[1]);
+				result.status != Tracker::OK)
+		{
+			std::cout << "error: That card is not on top of the infect deck" << std::endl;
+			return Console::Error;
+		}
+		else
+		{
+			std::cout << "Epidemic " << tracker.current_epidemics() << std::endl;
+			std::cout << "Uninfecting " << *result.card << std::endl;
+		}
+		
+		return static_cast<Console::ReturnCode>
+					(console.executeCommand("epidemic_stats"));
+	});
+	
+	console.registerCommand("epidemic_stats", [&](const Console::Arguments&)
+	{
+		if(records.structured())
+		{
+			records.epidemic_stats(tracker);
+			return 0;
+		}
+		
+		int n_draws = tracker.n_draws();
+		int total_cards = tracker.total_cards();
+		int current_epidemics = tracker.current_epidemics();
+		std::cout << "Epidemics so far: " << current_epidemics << std::endl;
+		std::cout << "Draws left: " << total_cards - n_draws << std::endl;
+		std::cout << "Turns left: " << (total_cards - n_draws) / 2 << std::endl;
+		auto [safe_phase, next_phase] = tracker.epidemic_window();
+		
+		if(n_draws + 2 <= safe_phase)
+		{
+			std::cout << "No epidemics for " << safe_phase - n_draws;
+			std::cout << " more draws. (" << (safe_phase - n_draws) / 2;
+			std::cout << " turns)" << std::endl;
+		}
+		else if(n_draws + 2 <= next_phase)
+		{
+			std::cout << "Epidemic is in the next " << next_phase - n_draws;
+			std::cout << " draws (" << 200.0 / (next_phase - n_draws);
+			std::cout << "% chance to draw this turn) " << std::endl;
+		}
+		else if(n_draws + 1 == next_phase)
+		{
+			std::cout << "Epidemic will be the next card drawn, ";
+			std::cout << "followed by a 1/";
+			std::cout << (tracker.cards_per_epidemic() +
+						  (current_epidemics < tracker.big_stacks()));
+			std::cout << " chance of drawing another after" << std::endl;
+		}
+		
+		return 0;
+	});
+	
+	console.registerCommand("infect_stats", [&](const Console::Arguments&)
+	{
+		if(records.structured())
+		{
+			records.infect_stats(tracker);
+			return 0;
+		}
+		
+		std::cout << "Infection Discard: {";
+		for(const auto &i : tracker.infection_discard())
+			std::cout << i << ", ";
+		std::cout << "}\n" << std::endl;
+		
+		std::cout << "The next infections are:" << std::endl;
+		const auto &infection_deck = tracker.infection_deck();
+		const auto &unknowns = tracker.unknown_infects();
+		for(size_t i = infection_deck.size(); i-- > 0;)
+		{
+			std::cout << "{";
+			for(const auto &j : infection_deck[i])
+				std::cout << j << ", ";
+			std::cout << "}";
+			if(unknowns[i])
+				std::cout << " less " << unknowns[i] << " infected unseen";
+			std::cout << "\n" << std::endl;
+		}
+		
+		return 0;
+	});
+	
+	console.registerCommand("card_stats", [&](const Console::Arguments&)
+	{
+		if(records.structured())
+		{
+			records.card_stats(tracker);
+			return 0;
+		}
+		
+		std::cout << "Cards left in player deck: {";
+		int counts[N_COLORS] = {0};
+		for(const auto &card : tracker.player_deck())
+		{
+			++counts[card.second];
+			std::cout << card << ", ";
+		}
+		std::cout << "}";
+		if(tracker.unknown_draws())
+			std::cout << " less " << tracker.unknown_draws() << " drawn unseen";
+		std::cout << "\n" << std::endl;
+		
+		for(int color = 0; color < N_COLORS; color++)
+		{
+			std::cout << std::make_pair(std::to_string(counts[color]) + " " +
+										color_to_string(color_t(color)),
+										color_t(color));
+			if(color < N_COLORS - 1)
+				std::cout << ", ";
+		}
+		std::cout << std::endl;
+		return 0;
+	});
+	
+	console.registerCommand("forecast", [&](const Console::Arguments& args)
+	{
+		Console::Arguments nexts(args.begin() + 1, args.end());
+		if(records.structured())
+		{
+			for(const auto &next : nexts)
+			{
+				if(auto result = tracker.resolve(next); result.status != Tracker::OK)
+				{
+					records.card(tracker, RecordWriter::FORECAST, next, result);
+					return Console::Error;
+				}
+			}
+			
+			if(auto result = tracker.forecast(nexts); result.status != Tracker::OK)
+			{
+				records.card(tracker, RecordWriter::FORECAST, result.card->first,
+							 result);
+				records.infect_stats(tracker);
+				return Console::Error;
+			}
+			
+			return static_cast<Console::ReturnCode>
+						(console.executeCommand("infect_stats"));
+		}
+		
+		for(const auto &next: nexts)
+		{
+			if(ambig(next) != 1)
+			{
+				console.executeCommand("infect_stats");
+				return Console::Error;
+			}
+		}
+		
+		if(auto result = tracker.forecast(nexts); result.status != Tracker::OK)
+		{
+			std::cout << "error: " << result.card->first;
+			std::cout << " is not at the top of the deck." << std::endl;
+			console.executeCommand("infect_stats");
+			return Console::Error;
+		}
+		
+		return static_cast<Console::ReturnCode>
+					(console.executeCommand("infect_stats"));
+	});
 	
-	for(std::istream_iterator<std::string> it(in);
-		it != std::istream_iterator<std::string>(); ++it)
+	console.registerCommand("forecast_best", [&](const Console::Arguments& args)
 	{
-		auto key = *it++;
-		ret.insert(std::make_pair(std::move(key), to_color(*it)));
+		Console::Arguments nexts(args.begin() + 1, args.end());
+		if(nexts.empty() || nexts.size() > 6)
+		{
+			report_error("Give the 1 to 6 cards on top of the infection deck");
+			return Console::Error;
+		}
+		
+		std::vector<ranked_forecast_t> ranked;
+		if(records.structured())
+		{
+			for(const auto &next : nexts)
+			{
+				if(auto result = tracker.resolve(next); result.status != Tracker::OK)
+				{
+					records.card(tracker, RecordWriter::FORECAST, next, result);
+					return Console::Error;
+				}
+			}
+			
+			auto result = tracker.forecast_best(nexts, 3, ranked);
+			if(result.status != Tracker::OK)
+			{
+				records.card(tracker, RecordWriter::FORECAST, result.card->first,
+							 result);
+				return Console::Error;
+			}
+			
+			records.forecast_best(tracker, ranked);
+			return Console::Ok;
+		}
+		
+		for(const auto &next : nexts)
+			if(ambig(next) != 1)
+				return Console::Error;
+		
+		if(auto result = tracker.forecast_best(nexts, 3, ranked);
+		   result.status != Tracker::OK)
+		{
+			std::cout << "error: " << result.card->first;
+			std::cout << " is not at the top of the deck." << std::endl;
+			return Console::Error;
+		}
+		
+		std::cout << "Best forecasts (top card first, risk over ";
+		std::cout << Tracker::risk_horizon << " turns):" << std::endl;
+		for(const auto &forecast : ranked)
+		{
+			std::cout << forecast.risk << ": ";
+			for(const auto *card : forecast.cards)
+				std::cout << *card << " ";
+			std::cout << std::endl;
+		}
+		
+		return Console::Ok;
+	});
+	
+	console.registerCommand("resilient_population",
+							[&](const Console::Arguments& args)
+	{
+		if(args.size() < 2)
+		{
+			report_error("Too few arguments");
+			return Console::Error;
+		}
+		
+		auto arg = args[1];
+		if(records.structured())
+		{
+			records.card(tracker, RecordWriter::RESILIENT_POPULATION, arg,
+						 tracker.resilient_population(arg));
+			return Console::Ok;
+		}
+		
+		if(ambig(arg) != 1)
+			return Console::Error;
+		
+		if(auto result = tracker.resilient_population(arg);
+		   result.status == Tracker::OK)
+		{
+			std::cout << "Erasing " << *result.card << std::endl;
+		}
+		
+		return Console::Ok;
+	});
+	
+	console.registerCommand("resilient_best", [&](const Console::Arguments&)
+	{
+		if(records.structured())
+		{
+			records.resilient_best(tracker, tracker.resilient_best());
+			return Console::Ok;
+		}
+		
+		std::cout << "Resilient population candidates (risk over ";
+		std::cout << Tracker::risk_horizon << " turns):" << std::endl;
+		for(const auto &[risk, card] : tracker.resilient_best())
+			std::cout << risk << ": " << *card << std::endl;
+		
+		return Console::Ok;
+	});
+	
+	console.registerCommand("cache_stats", [&](const Console::Arguments&)
+	{
+		const auto &cache = tracker.cache();
+		std::cout << "State " << std::hex << tracker.state_hash() << std::dec;
+		std::cout << ", " << cache.size() << " results cached, " << cache.hits();
+		std::cout << " hits, " << cache.misses() << " misses" << std::endl;
+		return Console::Ok;
+	});
+	
+	// every stats record at once, for dashboards polling the game
+	console.registerCommand("state", [&](const Console::Arguments&)
+	{
+		console.executeCommand("epidemic_stats");
+		console.executeCommand("infect_stats");
+		console.executeCommand("card_stats");
+		console.executeCommand("hands");
+		return Console::Ok;
+	});
+	
+	console.registerCommand("output", [&](const Console::Arguments& args)
+	{
+		auto format = args.size() > 1? to_format(args[1]) : RecordWriter::N_FORMATS;
+		if(format == RecordWriter::N_FORMATS)
+		{
+			report_error("usage: output <text|json|binary>");
+			return Console::Error;
+		}
+		
+		records.set_format(format);
+		records.cities(tracker);
+		return Console::Ok;
+	});
+	
+	/* Applies the commands in a log file, then each command appended to it,
+	 * until enter is pressed. Unlike run, a bad command doesn't stop it. The
+	 * stats a batch of commands changed are written after it.
+	 */
+	console.registerCommand("follow", [&](const Console::Arguments& args)
+	{
+		if(args.size() < 2)
+		{
+			report_error("usage: follow <log file>");
+			return Console::Error;
+		}
+		
+		LogFollower log(args[1]);
+		if(!log.good())
+		{
+			report_error("Could not follow " + args[1]);
+			return Console::Error;
+		}
+		
+		if(!records.structured())
+			std::cout << "Following " << args[1] << ", enter stops." << std::endl;
+		
+		static const std::map<std::string, std::vector<std::string>> changes = {
+			{"infect", {"infect_stats"}},
+			{"uninfect", {"infect_stats"}},
+			{"epidemic", {"infect_stats"}},
+			{"unepidemic", {"infect_stats"}},
+			{"resilient_population", {"infect_stats"}},
+			{"forecast", {"infect_stats"}},
+			{"reveal", {"infect_stats", "card_stats"}},
+			{"draw", {"card_stats", "hands"}},
+			{"undraw", {"card_stats", "hands"}},
+			{"give", {"hands"}},
+			{"discard", {"hands"}},
+			{"turn", {"infect_stats", "card_stats", "hands"}},
+			// none of the stats show stations, only routes do
+			{"station", {}},
+			{"unstation", {}},
+		};
+		
+		std::vector<std::string> lines;
+		while(true)
+		{
+			auto event = log.wait(lines, STDIN_FILENO);
+			if(event == LogFollower::TRUNCATED)
+			{
+				report_error(args[1] + " was truncated, reading it from the top");
+				continue;
+			}
+			if(event != LogFollower::LINES)
+			{
+				if(event == LogFollower::STOPPED)
+				{
+					std::string line;
+					std::getline(std::cin, line);
+				}
+				else
+					report_error("Stopped following " + args[1]);
+				break;
+			}
+			
+			std::set<std::string> stale;
+			for(const auto &line : lines)
+			{
+				std::istringstream iss(line);
+				std::string verb;
+				if(!(iss >> verb) || verb[0] == '#' || verb == "follow")
+					continue;
+				
+				if(console.executeCommand(line) == Console::Quit)
+					return Console::Quit;
+				if(auto stats = changes.find(verb); stats != changes.end())
+					stale.insert(stats->second.begin(), stats->second.end());
+			}
+			
+			for(const auto &stats : stale)
+				console.executeCommand(stats);
+		}
+		
+		return Console::Ok;
+	});
+	
+	/* Runs a few fixed cases, then a random stream of valid and invalid
+	 * commands through the console, checking the invariants after each one,
+	 * then restores the game.
+	 */
+	console.registerCommand("stress", [&](const Console::Arguments& args)
+	{
+		if(args.size() < 2)
+		{
+			std::cout << "usage: stress <commands> [seed]" << std::endl;
+			return Console::Error;
+		}
+		
+		long n_commands = std::atol(args[1].c_str());
+		unsigned long seed = args.size() > 2?
+			std::strtoul(args[2].c_str(), nullptr, 10) : std::random_device{}();
+		std::mt19937_64 rng(seed);
+		auto roll = [&rng](size_t n) { return size_t(rng() % n); };
+		
+		static const char * verbs[] = {"draw", "undraw", "infect", "uninfect",
+			"epidemic", "unepidemic", "forecast", "resilient_population",
+			"resilient_best", "epidemic_stats", "infect_stats", "card_stats",
+			"give 1", "give 2", "discard", "hands", "cure_odds", "reveal draw",
+			"reveal infect", "pile_odds", "turn", "turn 1 infect", "turn epidemic",
+			"station", "unstation", "route", "forecast_best", "output json",
+			"output binary", "output text"};
+		
+		// mostly real cards from a pile they might be in, sometimes
+		// ambiguous prefixes or garbage
+		auto random_card = [&]() -> std::string
+		{
+			const auto &strata = tracker.infection_deck();
+			const deck_t *piles[] = {&tracker.cities(), &tracker.player_deck(),
+				&tracker.player_drawn(), &tracker.infection_discard(),
+				strata.empty()? &tracker.cities() : &strata.back(),
+				strata.empty()? &tracker.cities() : &strata.front()};
+			const auto &pile = *piles[roll(std::size(piles))];
+			switch(roll(10))
+			{
+			case 0:
+				return "xyzzy";
+			case 1:
+				return std::string(1, 'A' + roll(26));
+			case 2:
+				return unknown_card;
+			default:
+				if(pile.empty())
+					return "";
+				return std::next(pile.begin(), roll(pile.size()))->first;
+			}
+		};
+		
+		auto saved = tracker;
+		auto format = records.format();
+		
+		// throws output away a buffer at a time
+		struct null_buffer_t: std::streambuf
+		{
+			char sink[1024];
+			int overflow(int c) override
+			{
+				setp(sink, sink + sizeof(sink));
+				return c;
+			}
+		} null_buffer;
+		auto cout_buffer = std::cout.rdbuf(&null_buffer);
+		
+		std::string command, broken;
+		auto expect = [&broken](bool ok, const std::string &what)
+		{
+			if(!ok && broken.empty())
+				broken = what;
+		};
+		
+		// cases the random stream is unlikely to hit, each from a new game
+		{
+			// a third player card in a turn is refused, logging nothing
+			tracker = new_game();
+			std::vector<std::string> names;
+			for(auto card = tracker.player_deck().begin(); names.size() < 3; ++card)
+				names.push_back(card->first);
+			auto hash = tracker.state_hash();
+			command = "turn 1 " + names[0] + " " + names[1] + " " + names[2];
+			expect(console.executeCommand(command) == Console::Error &&
+				   tracker.state_hash() == hash, "a three card turn was logged");
+			
+			// and the same through the C API
+			std::vector<const char *> c_events;
+			for(const auto &event : events)
+				c_events.push_back(event.c_str());
+			auto *c_tracker = pandemic_create(city_file.c_str(), c_events.data(),
+				c_events.size(), initial_draws, epidemics);
+			if(c_tracker)
+			{
+				const char *draws[] = {names[0].c_str(), names[1].c_str(),
+									   names[2].c_str()};
+				hash = pandemic_state_hash(c_tracker);
+				int failed = -1;
+				auto status = pandemic_turn(c_tracker, 1, draws, 3, nullptr, 0,
+											nullptr, 0, &failed);
+				expect(status == PANDEMIC_BAD_ARGUMENT && failed == 2 &&
+					   pandemic_state_hash(c_tracker) == hash,
+					   "pandemic_turn logged a three card turn");
+				pandemic_destroy(c_tracker);
+			}
+		}
+		{
+			// with every epidemic drawn nothing can reshuffle the top cards, so
+			// every order of them infects the same, even near the deck's end
+			tracker = new_game();
+			const auto &strata = tracker.infection_deck();
+			for(int i = 0; i < 9; i++)
+				tracker.infect(strata.back().begin()->first);
+			for(int i = 0; i < epidemics; i++)
+				tracker.epidemic(strata.front().begin()->first);
+			while(tracker.player_deck().size() > 1)
+				tracker.draw(tracker.player_deck().begin()->first);
+			
+			std::vector<std::string> names;
+			for(auto stratum = strata.rbegin(); stratum != strata.rend(); ++stratum)
+				for(auto card = stratum->begin(); card != stratum->end() &&
+					names.size() < 6; ++card)
+					names.push_back(card->first);
+			
+			std::vector<ranked_forecast_t> ranked;
+			command = "forecast_best";
+			for(const auto &name : names)
+				command += " " + name;
+			// all 720 orders of the six
+			tracker.forecast_best(names, 720, ranked);
+			expect(ranked.size() == 720 && std::all_of(ranked.begin(), ranked.end(),
+				[&](const ranked_forecast_t &order)
+				{
+					return std::abs(order.risk - ranked.front().risk) < 1e-9;
+				}), "forecast orders ranked apart after the last epidemic");
+		}
+		{
+			// epidemic stats read back as the tracker has them, both encodings
+			tracker = new_game();
+			const auto &strata = tracker.infection_deck();
+			for(int i = 0; i < 3; i++)
+				tracker.infect(strata.back().begin()->first);
+			tracker.epidemic(strata.front().begin()->first);
+			tracker.draw(tracker.player_deck().begin()->first);
+			
+			auto [safe_phase, next_phase] = tracker.epidemic_window();
+			int fields[] = {tracker.current_epidemics(), tracker.n_draws(),
+				tracker.total_cards() - tracker.n_draws(), safe_phase, next_phase,
+				tracker.n_infects(), tracker.expected_infects()};
+			
+			command = "epidemic_stats";
+			std::ostringstream binary, json;
+			RecordWriter(binary, RecordWriter::BINARY).epidemic_stats(tracker);
+			RecordWriter(json, RecordWriter::JSON).epidemic_stats(tracker);
+			
+			const auto bytes = binary.str();
+			auto byte = [&bytes](size_t i) { return int(uint8_t(bytes[i])); };
+			bool same = bytes.size() == 3 + 2 * std::size(fields) &&
+				byte(0) == RecordWriter::EPIDEMIC_STATS &&
+				(byte(1) | byte(2) << 8) == 2 * std::size(fields);
+			for(size_t i = 0; same && i < std::size(fields); i++)
+				same = int16_t(byte(3 + 2 * i) | byte(4 + 2 * i) << 8) == fields[i];
+			expect(same, "binary epidemic_stats read back wrong");
+			
+			const char * keys[] = {"epidemics", "draws", "draws_left",
+				"safe_phase", "next_phase", "infects", "expected"};
+			std::string expected = "{\"type\":\"epidemic_stats\"";
+			for(size_t i = 0; i < std::size(keys); i++)
+				expected += ",\"" + std::string(keys[i]) + "\":" +
+					std::to_string(fields[i]);
+			expect(json.str() == expected + "}\n",
+				   "JSON epidemic_stats read back wrong");
+		}
+		tracker = saved;
+		
+		long i = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(; i < n_commands && broken.empty(); i++)
+		{
+			std::string verb = verbs[roll(std::size(verbs))];
+			command = verb;
+			for(size_t n = roll(4); n > 0; n--)
+				command += " " + random_card();
+			
+			console.executeCommand(command);
+			// the route table only changes with the stations
+			broken = tracker.check(verb == "station" || verb == "unstation");
+		}
+		std::chrono::duration<double> elapsed =
+			std::chrono::steady_clock::now() - start;
+		
+		std::cout.rdbuf(cout_buffer);
+		tracker = std::move(saved);
+		records.set_format(format);
+		
+		std::cout << i << " commands in " << elapsed.count() << "s (";
+		std::cout << i / elapsed.count() << " commands/sec), seed ";
+		std::cout << seed << std::endl;
+		if(!broken.empty())
+		{
+			std::cout << "error: " << broken;
+			if(i > 0)
+				std::cout << " after command " << i;
+			std::cout << ": " << command << std::endl;
+			return Console::Error;
+		}
+		
+		return Console::Ok;
+	});
+	
+	while(console.readLine() != Console::Quit)
+	{
+		//console.setGreeting("(pandemic"s + reminder + ")");
 	}
 	
-	return ret;
+	return 0;
 }
 
 command_t parse_command(const std::string &command)
@@ -547,19 +1682,6 @@ command_t parse_command(const std::string &command)
 	return N_COMMANDS;
 }
 
-color_t to_color(const std::string &str)
-{
-	for(int i = 0; i < N_COLORS; i++)
-		if(str == colors[i]) return static_cast<color_t>(i);
-	
-	return N_COLORS;
-}
-
-std::string color_to_string(color_t color)
-{
-	return colors[static_cast<int>(color)];
-}
-
 int main(int argc, char *argv[])
 {
 	return run(argc > 1? argv[1]:"");
@@ -0,0 +1,261 @@
+#ifndef PANDEMIC_C_HEADER_FILE
+#define PANDEMIC_C_HEADER_FILE
+
+/* C interface to the pandemic tracker, built into libpandemic.
+ *
+ * Functions taking a card name accept any unambiguous, case insensitive
+ * prefix of it. Card names handed back stay valid until the tracker is
+ * destroyed. A command that fails leaves the game untouched.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The library is built with hidden visibility, so only these are exported. */
+#if defined(__GNUC__)
+#pragma GCC visibility push(default)
+#endif
+
+typedef struct pandemic_tracker pandemic_tracker;
+
+typedef enum pandemic_status {
+	PANDEMIC_OK = 0,
+	PANDEMIC_AMBIGUOUS,    /* the name matches more than one card */
+	PANDEMIC_INVALID,      /* the name matches no card */
+	PANDEMIC_NOT_IN_PILE,  /* the card isn't where the command needs it */
+	PANDEMIC_EMPTY_DECK,   /* the deck has run out */
+	PANDEMIC_OVER_RATE,    /* a turn infects more cards than the rate */
+	PANDEMIC_BAD_ARGUMENT, /* a player out of range, or a turn's card count */
+	PANDEMIC_FAILURE       /* bad arguments or out of memory */
+} pandemic_status;
+
+typedef enum pandemic_color {
+	PANDEMIC_YELLOW = 0,
+	PANDEMIC_RED,
+	PANDEMIC_BLUE,
+	PANDEMIC_BLACK,
+	PANDEMIC_EVENT
+} pandemic_color;
+
+typedef enum pandemic_pile {
+	PANDEMIC_PLAYER_DECK = 0,
+	PANDEMIC_PLAYER_DRAWN,
+	PANDEMIC_INFECTION_DISCARD,
+	PANDEMIC_INFECTION_REMOVED,
+	PANDEMIC_INFECTION_DECK, /* all strata, from the top */
+	PANDEMIC_N_PILES
+} pandemic_pile;
+
+typedef struct pandemic_card {
+	const char *name;
+	pandemic_color color;
+} pandemic_card;
+
+typedef struct pandemic_epidemic_stats {
+	int epidemics;
+	int draws;      /* player cards drawn after setup, epidemics included */
+	int draws_left;
+	int safe_phase; /* draws before the next epidemic's window opens */
+	int next_phase; /* draws by which the next epidemic has been drawn */
+	int infection_rate;
+	int infects;          /* infection cards drawn, setup included */
+	int expected_infects; /* how many the turns logged with turn should draw */
+} pandemic_epidemic_stats;
+
+typedef struct pandemic_ranked_forecast {
+	double risk;
+	int n_cards;
+	pandemic_card cards[6]; /* top card first */
+} pandemic_ranked_forecast;
+
+typedef enum pandemic_query {
+	PANDEMIC_ANY_OUTBREAK = 0, /* chance of at least one outbreak */
+	PANDEMIC_OUTBREAKS,        /* expected number of outbreaks */
+	PANDEMIC_INFECTED          /* chance of a given city being infected */
+} pandemic_query;
+
+typedef struct pandemic_estimate {
+	double mean;
+	double half_width; /* of the 95% confidence interval */
+	long samples;
+} pandemic_estimate;
+
+typedef struct pandemic_self_play_stats {
+	long games;
+	long turns;
+	long won;
+	long lost_to_outbreaks;
+	long lost_to_cubes;
+	long lost_to_cards; /* the player deck running out */
+} pandemic_self_play_stats;
+
+/* Called with each partial estimate while a simulation runs. */
+typedef void (*pandemic_progress)(const pandemic_estimate *estimate,
+								  void *user);
+
+typedef struct pandemic_ranked_card {
+	double risk;
+	pandemic_card card;
+} pandemic_ranked_card;
+
+/* Returns NULL if the cities file can't be read or the counts are bad. */
+pandemic_tracker *pandemic_create(const char *city_file,
+								  const char *const *events, int n_events,
+								  int initial_draws, int epidemics);
+void pandemic_destroy(pandemic_tracker *tracker);
+
+/* Single card commands. card, if not NULL, receives the card the name
+ * resolved to whenever it resolved.
+ */
+pandemic_status pandemic_draw(pandemic_tracker *tracker, const char *name,
+							  pandemic_card *card);
+pandemic_status pandemic_undraw(pandemic_tracker *tracker, const char *name,
+								pandemic_card *card);
+pandemic_status pandemic_infect(pandemic_tracker *tracker, const char *name,
+								pandemic_card *card);
+pandemic_status pandemic_uninfect(pandemic_tracker *tracker, const char *name,
+								  pandemic_card *card);
+pandemic_status pandemic_epidemic(pandemic_tracker *tracker, const char *name,
+								  pandemic_card *card);
+pandemic_status pandemic_unepidemic(pandemic_tracker *tracker,
+									const char *name, pandemic_card *card);
+pandemic_status pandemic_resilient_population(pandemic_tracker *tracker,
+											  const char *name,
+											  pandemic_card *card);
+
+/* A card taken from the top of the player or infection deck without anyone
+ * seeing which. It stays listed in its pile until it's revealed or the rest
+ * of the pile is accounted for.
+ */
+pandemic_status pandemic_draw_unknown(pandemic_tracker *tracker);
+pandemic_status pandemic_undraw_unknown(pandemic_tracker *tracker);
+pandemic_status pandemic_infect_unknown(pandemic_tracker *tracker);
+pandemic_status pandemic_uninfect_unknown(pandemic_tracker *tracker);
+
+/* Names a card that was taken unseen from PANDEMIC_PLAYER_DECK or
+ * PANDEMIC_INFECTION_DECK.
+ */
+pandemic_status pandemic_reveal(pandemic_tracker *tracker, pandemic_pile from,
+								const char *name, pandemic_card *card);
+
+/* Chance of the named card being in each pile, indexed by pandemic_pile. */
+pandemic_status pandemic_pile_odds(const pandemic_tracker *tracker,
+								   const char *name,
+								   double odds[PANDEMIC_N_PILES]);
+
+/* Moves a drawn card into the hand of a player numbered 0 to 999, failing
+ * with PANDEMIC_BAD_ARGUMENT for any other.
+ */
+pandemic_status pandemic_give(pandemic_tracker *tracker, int player,
+							  const char *name, pandemic_card *card);
+/* Takes a card out of whichever hand holds it. */
+pandemic_status pandemic_discard(pandemic_tracker *tracker, const char *name,
+								 pandemic_card *card);
+
+/* Reads the map's connections, one pair of city names to a line, so routes
+ * can be found. No stations are built, not even Atlanta's. Fails with more
+ * than 255 cities and events, which a route table can't hold.
+ */
+pandemic_status pandemic_set_connections(pandemic_tracker *tracker,
+										 const char *connection_file);
+pandemic_status pandemic_build_station(pandemic_tracker *tracker,
+									   const char *name, pandemic_card *card);
+pandemic_status pandemic_remove_station(pandemic_tracker *tracker,
+										const char *name, pandemic_card *card);
+/* Actions to get from one city to another, driving or shuttling between
+ * research stations. *actions is -1 if there's no way, or no map.
+ */
+pandemic_status pandemic_route(const pandemic_tracker *tracker,
+							   const char *from, const char *to, int *actions);
+
+/* Puts the named cards back on top of the infection deck, first on top. */
+pandemic_status pandemic_forecast(pandemic_tracker *tracker,
+								  const char *const *names, int n_names);
+
+/* Logs a whole turn: the player cards drawn, into player's hand unless it's
+ * negative, the bottom cards any epidemics infected, then up to the infection
+ * rate of infections, more failing with PANDEMIC_OVER_RATE. Draws and
+ * epidemics come to two cards, or fewer only when they're the last of the
+ * player deck, and player is at most 999, else the turn fails with
+ * PANDEMIC_BAD_ARGUMENT. A NULL name is a card nobody saw. If any of it fails
+ * none of it is logged, and failed, if not NULL, receives the index of the
+ * name that stopped it, counting on from the draws through the epidemics to
+ * the infections, or -1 for a bad player or a turn short of cards.
+ */
+pandemic_status pandemic_turn(pandemic_tracker *tracker, int player,
+							  const char *const *draws, int n_draws,
+							  const char *const *epidemics, int n_epidemics,
+							  const char *const *infections, int n_infections,
+							  int *failed);
+
+/* Ranks orderings of up to 6 named top cards, lowest risk first. *n_ranked
+ * holds the room in ranked on the way in and the number filled on the way
+ * out.
+ */
+pandemic_status pandemic_forecast_best(const pandemic_tracker *tracker,
+									   const char *const *names, int n_names,
+									   pandemic_ranked_forecast *ranked,
+									   int *n_ranked);
+
+/* Ranks the infection discard for resilient population, riskiest first.
+ * Returns the number of candidates, filling at most max_ranked of them.
+ */
+int pandemic_resilient_best(const pandemic_tracker *tracker,
+							pandemic_ranked_card *ranked, int max_ranked);
+
+/* Chance of holding the cards to cure each color, indexed by pandemic_color,
+ * within turns player turns. Turns past the end of the player deck count as
+ * drawing the rest of it; negative turns fail.
+ */
+pandemic_status pandemic_cure_odds(const pandemic_tracker *tracker, int turns,
+								   double odds[PANDEMIC_EVENT]);
+
+/* Monte Carlo estimate of a query over the next turns' infections, sampling
+ * on every core for up to budget_ms or until within precision of the mean
+ * either way. city names the card PANDEMIC_INFECTED asks about, and is
+ * otherwise ignored. progress may be NULL. Estimates of an unchanged game
+ * state carry on from the last one.
+ */
+pandemic_status pandemic_simulate(const pandemic_tracker *tracker,
+								  pandemic_query query, const char *city,
+								  int turns, double budget_ms, double precision,
+								  pandemic_progress progress, void *user,
+								  pandemic_estimate *estimate);
+
+/* Plays games of 2 to 4 players against itself, on every core, from the
+ * start of the game the tracker is set up for. Needs the map's connections.
+ * Game n of a seed always goes the same way. If out_file isn't NULL every
+ * game is written to it as binary records.
+ */
+pandemic_status pandemic_self_play(const pandemic_tracker *tracker, int players,
+								   long games, uint64_t seed,
+								   const char *out_file,
+								   pandemic_self_play_stats *stats);
+
+/* 64 bit hash of the whole game state, equal for equal states. */
+uint64_t pandemic_state_hash(const pandemic_tracker *tracker);
+
+void pandemic_get_epidemic_stats(const pandemic_tracker *tracker,
+								 pandemic_epidemic_stats *stats);
+
+/* Returns the number of cards in the pile, filling at most max_cards. */
+int pandemic_pile_cards(const pandemic_tracker *tracker, pandemic_pile pile,
+						pandemic_card *cards, int max_cards);
+
+/* Infection deck strata, numbered from 0 at the top of the deck. */
+int pandemic_strata(const pandemic_tracker *tracker);
+int pandemic_stratum_cards(const pandemic_tracker *tracker, int stratum,
+						   pandemic_card *cards, int max_cards);
+
+#if defined(__GNUC__)
+#pragma GCC visibility pop
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,566 @@
+#include "pandemic.h"
+#include "Tracker.hpp"
+#include "Simulation.hpp"
+#include "Routes.hpp"
+#include "SelfPlay.hpp"
+#include "Records.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <new>
+
+struct pandemic_tracker
+{
+	Tracker tracker;
+};
+
+namespace {
+
+	pandemic_card to_c(const Tracker &tracker, const card_t &card)
+	{
+		// names point into cities(), which outlives every other pile's nodes
+		const auto &city = *tracker.cities().find(card.first);
+		return {city.first.c_str(), static_cast<pandemic_color>(city.second)};
+	}
+
+	int to_c(const Tracker &tracker, const deck_t &pile,
+			 pandemic_card *cards, int max_cards)
+	{
+		int n = 0;
+		for(const auto &card : pile)
+			if(n < max_cards)
+				cards[n++] = to_c(tracker, card);
+
+		return pile.size();
+	}
+
+	using command_t = Tracker::result_t (Tracker::*)(const std::string &);
+	using unknown_command_t = Tracker::result_t (Tracker::*)();
+
+	pandemic_status run(pandemic_tracker *t, command_t command,
+						const char *name, pandemic_card *card)
+	{
+		if(!t || !name)
+			return PANDEMIC_FAILURE;
+
+		try
+		{
+			auto ret = (t->tracker.*command)(name);
+			if(card && ret.card)
+				*card = to_c(t->tracker, *ret.card);
+			return static_cast<pandemic_status>(ret.status);
+		}
+		catch(...)
+		{
+			return PANDEMIC_FAILURE;
+		}
+	}
+
+	pandemic_status run(pandemic_tracker *t, unknown_command_t command)
+	{
+		if(!t)
+			return PANDEMIC_FAILURE;
+
+		return static_cast<pandemic_status>((t->tracker.*command)().status);
+	}
+
+}  /* namespace  */
+
+extern "C" {
+
+pandemic_tracker *pandemic_create(const char *city_file,
+								  const char *const *events, int n_events,
+								  int initial_draws, int epidemics)
+{
+	if(!city_file || (n_events > 0 && !events) || epidemics <= 0 ||
+	   initial_draws < 0 || !std::ifstream(city_file))
+		return nullptr;
+
+	try
+	{
+		auto cities = load_cities(city_file);
+		std::vector<std::string> names(events, events + std::max(n_events, 0));
+		return new pandemic_tracker{
+			Tracker(std::move(cities), names, initial_draws, epidemics)};
+	}
+	catch(...)
+	{
+		return nullptr;
+	}
+}
+
+void pandemic_destroy(pandemic_tracker *tracker)
+{
+	delete tracker;
+}
+
+pandemic_status pandemic_draw(pandemic_tracker *tracker, const char *name,
+							  pandemic_card *card)
+{
+	return run(tracker, &Tracker::draw, name, card);
+}
+
+pandemic_status pandemic_undraw(pandemic_tracker *tracker, const char *name,
+								pandemic_card *card)
+{
+	return run(tracker, &Tracker::undraw, name, card);
+}
+
+pandemic_status pandemic_infect(pandemic_tracker *tracker, const char *name,
+								pandemic_card *card)
+{
+	return run(tracker, &Tracker::infect, name, card);
+}
+
+pandemic_status pandemic_uninfect(pandemic_tracker *tracker, const char *name,
+								  pandemic_card *card)
+{
+	return run(tracker, &Tracker::uninfect, name, card);
+}
+
+pandemic_status pandemic_epidemic(pandemic_tracker *tracker, const char *name,
+								  pandemic_card *card)
+{
+	return run(tracker, &Tracker::epidemic, name, card);
+}
+
+pandemic_status pandemic_unepidemic(pandemic_tracker *tracker,
+									const char *name, pandemic_card *card)
+{
+	return run(tracker, &Tracker::unepidemic, name, card);
+}
+
+pandemic_status pandemic_resilient_population(pandemic_tracker *tracker,
+											  const char *name,
+											  pandemic_card *card)
+{
+	return run(tracker, &Tracker::resilient_population, name, card);
+}
+
+pandemic_status pandemic_draw_unknown(pandemic_tracker *tracker)
+{
+	return run(tracker, &Tracker::draw_unknown);
+}
+
+pandemic_status pandemic_undraw_unknown(pandemic_tracker *tracker)
+{
+	return run(tracker, &Tracker::undraw_unknown);
+}
+
+pandemic_status pandemic_infect_unknown(pandemic_tracker *tracker)
+{
+	return run(tracker, &Tracker::infect_unknown);
+}
+
+pandemic_status pandemic_uninfect_unknown(pandemic_tracker *tracker)
+{
+	return run(tracker, &Tracker::uninfect_unknown);
+}
+
+pandemic_status pandemic_reveal(pandemic_tracker *tracker, pandemic_pile from,
+								const char *name, pandemic_card *card)
+{
+	if(!tracker || !name ||
+	   (from != PANDEMIC_PLAYER_DECK && from != PANDEMIC_INFECTION_DECK))
+		return PANDEMIC_FAILURE;
+
+	try
+	{
+		auto ret = tracker->tracker.reveal(static_cast<pile_t>(from), name);
+		if(card && ret.card)
+			*card = to_c(tracker->tracker, *ret.card);
+		return static_cast<pandemic_status>(ret.status);
+	}
+	catch(...)
+	{
+		return PANDEMIC_FAILURE;
+	}
+}
+
+pandemic_status pandemic_pile_odds(const pandemic_tracker *tracker,
+								   const char *name,
+								   double odds[PANDEMIC_N_PILES])
+{
+	if(!tracker || !name || !odds)
+		return PANDEMIC_FAILURE;
+
+	auto ret = tracker->tracker.resolve(name);
+	if(ret.status == Tracker::OK)
+	{
+		auto pile_odds = tracker->tracker.pile_odds(*ret.card);
+		std::copy(pile_odds.begin(), pile_odds.end(), odds);
+	}
+
+	return static_cast<pandemic_status>(ret.status);
+}
+
+pandemic_status pandemic_give(pandemic_tracker *tracker, int player,
+							  const char *name, pandemic_card *card)
+{
+	if(!tracker || !name)
+		return PANDEMIC_FAILURE;
+
+	try
+	{
+		auto ret = tracker->tracker.give(player, name);
+		if(card && ret.card)
+			*card = to_c(tracker->tracker, *ret.card);
+		return static_cast<pandemic_status>(ret.status);
+	}
+	catch(...)
+	{
+		return PANDEMIC_FAILURE;
+	}
+}
+
+pandemic_status pandemic_discard(pandemic_tracker *tracker, const char *name,
+								 pandemic_card *card)
+{
+	return run(tracker, &Tracker::discard, name, card);
+}
+
+pandemic_status pandemic_set_connections(pandemic_tracker *tracker,
+										 const char *connection_file)
+{
+	if(!tracker || !connection_file || !std::ifstream(connection_file))
+		return PANDEMIC_FAILURE;
+
+	try
+	{
+		return tracker->tracker.set_connections(load_connections(connection_file))?
+			PANDEMIC_OK : PANDEMIC_FAILURE;
+	}
+	catch(...)
+	{
+		return PANDEMIC_FAILURE;
+	}
+}
+
+pandemic_status pandemic_build_station(pandemic_tracker *tracker,
+									   const char *name, pandemic_card *card)
+{
+	return run(tracker, &Tracker::build_station, name, card);
+}
+
+pandemic_status pandemic_remove_station(pandemic_tracker *tracker,
+										const char *name, pandemic_card *card)
+{
+	return run(tracker, &Tracker::remove_station, name, card);
+}
+
+pandemic_status pandemic_route(const pandemic_tracker *tracker,
+							   const char *from, const char *to, int *actions)
+{
+	if(!tracker || !from || !to || !actions)
+		return PANDEMIC_FAILURE;
+
+	*actions = -1;
+	const auto &t = tracker->tracker;
+	auto a = t.resolve(from), b = t.resolve(to);
+	for(const auto &ret : {a, b})
+		if(ret.status != Tracker::OK)
+			return static_cast<pandemic_status>(ret.status);
+
+	const auto &routes = t.routes();
+	if(!routes.empty())
+	{
+		int distance = routes.distance(t.index(*a.card), t.index(*b.card));
+		if(distance != RouteMap::unreachable)
+			*actions = distance;
+	}
+
+	return PANDEMIC_OK;
+}
+
+pandemic_status pandemic_forecast(pandemic_tracker *tracker,
+								  const char *const *names, int n_names)
+{
+	if(!tracker || n_names < 0 || (n_names > 0 && !names))
+		return PANDEMIC_FAILURE;
+
+	try
+	{
+		std::vector<std::string> cards(names, names + n_names);
+		return static_cast<pandemic_status>(tracker->tracker.forecast(cards).status);
+	}
+	catch(...)
+	{
+		return PANDEMIC_FAILURE;
+	}
+}
+
+pandemic_status pandemic_turn(pandemic_tracker *tracker, int player,
+							  const char *const *draws, int n_draws,
+							  const char *const *epidemics, int n_epidemics,
+							  const char *const *infections, int n_infections,
+							  int *failed)
+{
+	if(failed)
+		*failed = -1;
+	if(!tracker || n_draws < 0 || n_epidemics < 0 || n_infections < 0 ||
+	   (n_draws > 0 && !draws) || (n_epidemics > 0 && !epidemics) ||
+	   (n_infections > 0 && !infections))
+		return PANDEMIC_FAILURE;
+
+	auto names = [](const char *const *names, int n_names)
+	{
+		std::vector<std::string> ret;
+		for(int i = 0; i < n_names; i++)
+			ret.push_back(names[i]? names[i] : "");
+		return ret;
+	};
+
+	try
+	{
+		Tracker::turn_t turn;
+		turn.player = player;
+		turn.draws = names(draws, n_draws);
+		turn.epidemics = names(epidemics, n_epidemics);
+		turn.infections = names(infections, n_infections);
+		auto ret = tracker->tracker.turn(turn);
+		if(ret.result.status != Tracker::OK && failed)
+		{
+			// the events are numbered as if they were one list
+			int offset = 0;
+			for(const auto *events : {&turn.draws, &turn.epidemics,
+									  &turn.infections})
+			{
+				if(ret.input >= events->data() &&
+				   ret.input < events->data() + events->size())
+					*failed = offset + (ret.input - events->data());
+				offset += events->size();
+			}
+		}
+		return static_cast<pandemic_status>(ret.result.status);
+	}
+	catch(...)
+	{
+		return PANDEMIC_FAILURE;
+	}
+}
+
+pandemic_status pandemic_forecast_best(const pandemic_tracker *tracker,
+									   const char *const *names, int n_names,
+									   pandemic_ranked_forecast *ranked,
+									   int *n_ranked)
+{
+	if(!tracker || !names || !n_ranked || *n_ranked < 0 || n_names < 1 ||
+	   n_names > 6 || (*n_ranked > 0 && !ranked))
+		return PANDEMIC_FAILURE;
+
+	try
+	{
+		std::vector<std::string> cards(names, names + n_names);
+		std::vector<ranked_forecast_t> best;
+		auto ret = tracker->tracker.forecast_best(cards, *n_ranked, best);
+
+		*n_ranked = best.size();
+		for(size_t i = 0; i < best.size(); i++)
+		{
+			ranked[i].risk = best[i].risk;
+			ranked[i].n_cards = best[i].cards.size();
+			for(size_t c = 0; c < best[i].cards.size(); c++)
+				ranked[i].cards[c] = to_c(tracker->tracker, *best[i].cards[c]);
+		}
+
+		return static_cast<pandemic_status>(ret.status);
+	}
+	catch(...)
+	{
+		return PANDEMIC_FAILURE;
+	}
+}
+
+int pandemic_resilient_best(const pandemic_tracker *tracker,
+							pandemic_ranked_card *ranked, int max_ranked)
+{
+	if(!tracker)
+		return 0;
+
+	try
+	{
+		auto best = tracker->tracker.resilient_best();
+		for(int i = 0; i < int(best.size()) && i < max_ranked; i++)
+			ranked[i] = {best[i].first, to_c(tracker->tracker, *best[i].second)};
+
+		return best.size();
+	}
+	catch(...)
+	{
+		return 0;
+	}
+}
+
+pandemic_status pandemic_cure_odds(const pandemic_tracker *tracker, int turns,
+								   double odds[PANDEMIC_EVENT])
+{
+	if(!tracker || !odds || turns < 0)
+		return PANDEMIC_FAILURE;
+
+	try
+	{
+		auto cure_odds = tracker->tracker.cure_odds(turns);
+		std::copy(cure_odds.begin(), cure_odds.end(), odds);
+		return PANDEMIC_OK;
+	}
+	catch(...)
+	{
+		return PANDEMIC_FAILURE;
+	}
+}
+
+pandemic_status pandemic_simulate(const pandemic_tracker *tracker,
+								  pandemic_query query, const char *city,
+								  int turns, double budget_ms, double precision,
+								  pandemic_progress progress, void *user,
+								  pandemic_estimate *estimate)
+{
+	if(!tracker || !estimate || turns < 0 || !(budget_ms >= 0) ||
+	   !(precision >= 0) || query < PANDEMIC_ANY_OUTBREAK ||
+	   query > PANDEMIC_INFECTED || (query == PANDEMIC_INFECTED && !city))
+		return PANDEMIC_FAILURE;
+
+	const auto &t = tracker->tracker;
+	const card_t *card = nullptr;
+	if(query == PANDEMIC_INFECTED)
+	{
+		auto ret = t.resolve(city);
+		if(ret.status != Tracker::OK)
+			return static_cast<pandemic_status>(ret.status);
+		card = ret.card;
+	}
+
+	auto to_estimate = [](const estimate_t &e) -> pandemic_estimate
+	{
+		return {e.mean, e.samples? e.half_width() : 0.0, e.samples};
+	};
+
+	try
+	{
+		InfectionSampler sampler(t, InfectionSampler::query_t(query), turns,
+								 card);
+		progress_t on_progress;
+		if(progress)
+			on_progress = [&](const estimate_t &e)
+			{
+				auto partial = to_estimate(e);
+				progress(&partial, user);
+			};
+		*estimate = to_estimate(simulate(t, sampler,
+								  std::chrono::duration<double, std::milli>(budget_ms),
+								  precision, on_progress));
+		return PANDEMIC_OK;
+	}
+	catch(...)
+	{
+		return PANDEMIC_FAILURE;
+	}
+}
+
+pandemic_status pandemic_self_play(const pandemic_tracker *tracker, int players,
+								   long games, uint64_t seed,
+								   const char *out_file,
+								   pandemic_self_play_stats *stats)
+{
+	if(!tracker || !stats || players < policy_t::min_players ||
+	   players > policy_t::max_players || games < 0 ||
+	   tracker->tracker.routes().empty())
+		return PANDEMIC_FAILURE;
+
+	const auto &t = tracker->tracker;
+	try
+	{
+		policy_t policy;
+		policy.players = players;
+		std::ofstream file;
+		std::function<void(const game_record_t &)> record;
+		RecordWriter records(file, RecordWriter::BINARY);
+		if(out_file)
+		{
+			file.open(out_file, std::ios::binary);
+			if(!file)
+				return PANDEMIC_FAILURE;
+			records.cities(t);
+			record = [&](const game_record_t &game) { records.game(t, game); };
+		}
+
+		auto ret = self_play(t, policy, games, seed, record);
+		*stats = {ret.games, ret.turns, ret.outcomes[game_record_t::WON],
+				  ret.outcomes[game_record_t::OUTBREAKS],
+				  ret.outcomes[game_record_t::CUBES],
+				  ret.outcomes[game_record_t::CARDS]};
+		return file.is_open() && !file? PANDEMIC_FAILURE : PANDEMIC_OK;
+	}
+	catch(...)
+	{
+		return PANDEMIC_FAILURE;
+	}
+}
+
+uint64_t pandemic_state_hash(const pandemic_tracker *tracker)
+{
+	return tracker? tracker->tracker.state_hash() : 0;
+}
+
+void pandemic_get_epidemic_stats(const pandemic_tracker *tracker,
+								 pandemic_epidemic_stats *stats)
+{
+	if(!tracker || !stats)
+		return;
+
+	const auto &t = tracker->tracker;
+	auto [safe_phase, next_phase] = t.epidemic_window();
+	*stats = {t.current_epidemics(), t.n_draws(), t.total_cards() - t.n_draws(),
+			  safe_phase, next_phase, infection_rate(t.current_epidemics()),
+			  t.n_infects(), t.expected_infects()};
+}
+
+int pandemic_pile_cards(const pandemic_tracker *tracker, pandemic_pile pile,
+						pandemic_card *cards, int max_cards)
+{
+	if(!tracker)
+		return 0;
+
+	const auto &t = tracker->tracker;
+	switch(pile)
+	{
+	case PANDEMIC_PLAYER_DECK:
+		return to_c(t, t.player_deck(), cards, max_cards);
+	case PANDEMIC_PLAYER_DRAWN:
+		return to_c(t, t.player_drawn(), cards, max_cards);
+	case PANDEMIC_INFECTION_DISCARD:
+		return to_c(t, t.infection_discard(), cards, max_cards);
+	case PANDEMIC_INFECTION_REMOVED:
+		return to_c(t, t.infection_removed(), cards, max_cards);
+	case PANDEMIC_INFECTION_DECK:
+	{
+		int n = 0;
+		const auto &strata = t.infection_deck();
+		for(auto i = strata.rbegin(); i != strata.rend(); ++i)
+			n += to_c(t, *i, cards + std::min(n, max_cards),
+					  std::max(max_cards - n, 0));
+		return n;
+	}
+	case PANDEMIC_N_PILES:
+		break;
+	}
+
+	return 0;
+}
+
+int pandemic_strata(const pandemic_tracker *tracker)
+{
+	return tracker? tracker->tracker.infection_deck().size() : 0;
+}
+
+int pandemic_stratum_cards(const pandemic_tracker *tracker, int stratum,
+						   pandemic_card *cards, int max_cards)
+{
+	if(!tracker || stratum < 0 || stratum >= pandemic_strata(tracker))
+		return 0;
+
+	const auto &strata = tracker->tracker.infection_deck();
+	return to_c(tracker->tracker, strata.rbegin()[stratum], cards, max_cards);
+}
+
+}